@@ -0,0 +1,78 @@
+// Compares fan-out resizes into tightly packed CImg outputs with resizes into aligned_image
+// outputs, whose padded rows are written in whole aligned vector blocks.
+//
+// Usage: bench_aligned_rows [width] [height] [threads] [repeats]
+// Defaults: a 4000 x 3000 RGB source, all cores, 5 repeats (best time is reported).
+// Output widths are deliberately not multiples of the vector width.
+
+#include "CImg.h"
+#include "aligned_image.h"
+#include "resize_fanout.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cimg_library;
+
+namespace {
+
+double best_seconds(const CImg<unsigned char>& source, const resize_target& target, const mutable_image_view& output,
+                    task_scheduler& scheduler, int repeats) {
+    double best = 0.0;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        resize_fanout_into(source, {target}, {output}, scheduler);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = i == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 4000;
+    int height = argc > 2 ? std::atoi(argv[2]) : 3000;
+    std::size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    int repeats = argc > 4 ? std::max(1, std::atoi(argv[4])) : 5;
+
+    CImg<unsigned char> source(width, height, 1, 3);
+    cimg_forXYC(source, x, y, c) {
+        source(x, y, 0, c) = static_cast<unsigned char>((x * 3 + y * 5 + c * 85) & 0xFF);
+    }
+
+    task_scheduler scheduler(threads);
+    std::cout << "Source " << width << "x" << height << " RGB, " << scheduler.size() << " threads, best of "
+              << repeats << std::endl;
+    std::cout << std::left << std::setw(10) << "method" << std::setw(14) << "output" << std::setw(14) << "packed ms"
+              << std::setw(14) << "aligned ms" << "speedup" << std::endl;
+
+    bool identical = true;
+    for (const std::string method : {"bilinear", "nearest"}) {
+        for (float scale : {0.3f, 0.77f, 1.9f}) {
+            resize_target target{std::max(1, static_cast<int>(width * scale)) | 1, std::max(1, static_cast<int>(height * scale)), method};
+            CImg<unsigned char> packed(target.width, target.height, 1, 3);
+            aligned_image aligned(target.width, target.height, 3);
+            double packed_seconds = best_seconds(source, target, packed, scheduler, repeats);
+            double aligned_seconds = best_seconds(source, target, aligned, scheduler, repeats);
+            identical = identical && packed == aligned.to_cimg();
+
+            std::cout << std::left << std::setw(10) << method
+                      << std::setw(14) << (std::to_string(target.width) + "x" + std::to_string(target.height))
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(14) << packed_seconds * 1e3 << std::setw(14) << aligned_seconds * 1e3
+                      << std::setprecision(2) << packed_seconds / aligned_seconds << "x" << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+    if (!identical) {
+        std::cerr << "error: packed and aligned outputs differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
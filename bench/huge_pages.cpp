@@ -0,0 +1,186 @@
+// Measures how huge-page backing affects dTLB misses and time of large resizes.
+//
+// The source and output live in memory from a huge_page_resource in each mode:
+//   4k       the upstream allocator, i.e. ordinary 4 KiB pages
+//   thp      2 MiB-aligned mappings with madvise(MADV_HUGEPAGE)
+//   hugetlb  the hugetlbfs pool (falls back to thp when /proc/sys/vm/nr_hugepages is 0)
+// Two passes are timed: the per-pixel bilinear kernel, whose every sample touches four source
+// rows in each of four channel planes, and the separable fan-out, whose vertical pass reads
+// two resampled rows per output row. dTLB load misses come from perf_event_open and show
+// as n/a where perf counters are unavailable (e.g. in some containers); AnonHugePages
+// reports how much of the process the kernel actually backed with huge pages.
+//
+// Usage: bench_huge_pages [width] [height] [threads] [repeats]
+// Defaults: an 8000 x 6000 RGBA source (192 MB) halved, all cores, 3 repeats.
+
+#include "aligned_image.h"
+#include "huge_pages.h"
+#include "resize_fanout.h"
+#include "resizer_factory.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <memory>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief Counts dTLB load misses of the whole process (all threads created after it).
+ */
+class tlb_counter {
+public:
+    tlb_counter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~tlb_counter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start() {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    long long stop() {
+        long long count = -1;
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                count = -1;
+            }
+        }
+        return count;
+    }
+
+private:
+    int fd = -1;
+};
+
+/**
+ * @brief Returns AnonHugePages of this process in MiB, or -1 if it cannot be read.
+ */
+long anon_huge_mib() {
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    std::string key;
+    long kib;
+    while (rollup >> key) {
+        if (key == "AnonHugePages:" && rollup >> kib) {
+            return kib / 1024;
+        }
+    }
+    return -1;
+}
+
+struct measurement {
+    double seconds = 0.0;
+    long long misses = -1;
+};
+
+measurement best_of(int repeats, tlb_counter& counter, const std::function<void()>& pass) {
+    measurement best;
+    for (int i = 0; i < repeats; ++i) {
+        counter.start();
+        auto start = std::chrono::steady_clock::now();
+        pass();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        long long misses = counter.stop();
+        if (i == 0 || seconds < best.seconds) {
+            best.seconds = seconds;
+            best.misses = misses;
+        }
+    }
+    return best;
+}
+
+std::string format_misses(long long misses) {
+    return misses < 0 ? "n/a" : std::to_string(misses / 1000) + "k";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 8000;
+    int height = argc > 2 ? std::atoi(argv[2]) : 6000;
+    std::size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    int repeats = argc > 4 ? std::max(1, std::atoi(argv[4])) : 3;
+    const int channels = 4;
+    int new_width = std::max(1, width / 2);
+    int new_height = std::max(1, height / 2);
+
+    task_scheduler scheduler(threads);
+    tlb_counter counter;
+    std::unique_ptr<resize_image_base> resizer = create_resizer("bilinear");
+    std::cout << width << "x" << height << " RGBA -> " << new_width << "x" << new_height << ", " << scheduler.size()
+              << " threads, best of " << repeats << (counter.available() ? "" : " (perf counters unavailable)") << std::endl;
+    std::cout << std::left << std::setw(9) << "backing" << std::setw(12) << "kernel ms" << std::setw(14) << "kernel dTLB"
+              << std::setw(12) << "fanout ms" << std::setw(14) << "fanout dTLB" << "AnonHugePages MiB" << std::endl;
+
+    struct backing {
+        const char* name;
+        huge_page_mode mode;
+    };
+    for (const backing& mode : {backing{"4k", huge_page_mode::off}, backing{"thp", huge_page_mode::transparent},
+                                backing{"hugetlb", huge_page_mode::hugetlb}}) {
+        huge_page_resource resource(mode.mode);
+        std::size_t source_bytes = static_cast<std::size_t>(width) * height * channels;
+        auto* source_pixels = static_cast<unsigned char*>(resource.allocate(source_bytes, image_row_alignment));
+        std::size_t output_bytes = static_cast<std::size_t>(aligned_row_stride(new_width)) * new_height * channels;
+        auto* output_pixels = static_cast<unsigned char*>(resource.allocate(output_bytes, image_row_alignment));
+        mutable_image_view source = mutable_image_view::planar(source_pixels, width, height, channels);
+        mutable_image_view output = mutable_image_view::aligned(output_pixels, new_width, new_height, channels, aligned_row_stride(new_width));
+
+        for (int c = 0; c < channels; ++c) {
+            for (int y = 0; y < height; ++y) {
+                unsigned char* row = source.row(y, c);
+                for (int x = 0; x < width; ++x) {
+                    row[x] = static_cast<unsigned char>((x * 3 + y * 5 + c * 85) & 0xFF);
+                }
+            }
+        }
+        std::memset(output_pixels, 0, output_bytes);
+
+        measurement kernel = best_of(repeats, counter, [&] { resizer->resize_parallel(source, output, scheduler); });
+        measurement fanout = best_of(repeats, counter, [&] {
+            resize_fanout_into(source, {resize_target{new_width, new_height, "bilinear"}}, {output}, scheduler);
+        });
+        long huge = anon_huge_mib();
+        huge_page_stats stats = resource.stats();
+
+        std::cout << std::left << std::setw(9) << mode.name << std::fixed << std::setprecision(1)
+                  << std::setw(12) << kernel.seconds * 1e3 << std::setw(14) << format_misses(kernel.misses)
+                  << std::setw(12) << fanout.seconds * 1e3 << std::setw(14) << format_misses(fanout.misses)
+                  << huge << (stats.fallbacks > 0 ? "  (hugetlb pool empty, used thp)" : "") << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+
+        resource.deallocate(output_pixels, output_bytes, image_row_alignment);
+        resource.deallocate(source_pixels, source_bytes, image_row_alignment);
+    }
+    return 0;
+}
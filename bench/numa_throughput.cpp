@@ -0,0 +1,110 @@
+// Measures how buffer placement affects resize throughput on NUMA machines.
+//
+// Every job resizes its own source into its own output, both first touched before the
+// timed region by a thread on a chosen node. Three placements are compared:
+//   unpinned    workers float freely; buffers touched by an unpinned thread (the old behaviour)
+//   cross-node  workers pinned per node; a job runs on node n with buffers on node n + 1
+//   node-local  workers pinned per node; a job runs on the node that holds its buffers
+// On a single-node machine the three rows only differ by pinning overhead.
+//
+// Usage: bench_numa_throughput [width] [height] [jobs] [threads] [repeats]
+// Defaults: 3072 x 2048 RGB sources halved with bilinear, 8 jobs, all cores, 3 repeats.
+
+#include "CImg.h"
+#include "numa_topology.h"
+#include "resizer_factory.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cimg_library;
+
+namespace {
+
+struct job_buffers {
+    CImg<unsigned char> source;
+    CImg<unsigned char> result;
+};
+
+/**
+ * @brief Allocates and first-touches a job's buffers, from a thread pinned to a node when pin is set.
+ */
+void place(job_buffers& job, const CImg<unsigned char>& pattern, int new_width, int new_height, bool pin, std::size_t node) {
+    std::thread toucher([&] {
+        if (pin) {
+            numa_topology::system().pin_current_thread(node);
+        }
+        job.source = pattern;
+        job.result.assign(new_width, new_height, 1, pattern.spectrum(), 0);
+    });
+    toucher.join();
+}
+
+double run(const resize_image_base& resizer, std::vector<job_buffers>& jobs, task_scheduler& scheduler, bool by_node) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t j = 0; j < jobs.size(); ++j) {
+        auto task = [&, j] {
+            resizer.resize_parallel(jobs[j].source, jobs[j].result, scheduler);
+        };
+        if (by_node) {
+            scheduler.submit(task, j % scheduler.node_count());
+        } else {
+            scheduler.submit(task);
+        }
+    }
+    scheduler.wait_idle();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 3072;
+    int height = argc > 2 ? std::atoi(argv[2]) : 2048;
+    std::size_t job_count = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 8;
+    std::size_t threads = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+    int repeats = argc > 5 ? std::max(1, std::atoi(argv[5])) : 3;
+
+    CImg<unsigned char> pattern(width, height, 1, 3);
+    cimg_forXYC(pattern, x, y, c) {
+        pattern(x, y, 0, c) = static_cast<unsigned char>((x * 3 + y * 5 + c * 85) & 0xFF);
+    }
+    std::unique_ptr<resize_image_base> resizer = create_resizer("bilinear");
+    int new_width = std::max(1, width / 2);
+    int new_height = std::max(1, height / 2);
+    double megabytes = job_count * (static_cast<double>(width) * height + static_cast<double>(new_width) * new_height) * 3 / 1e6;
+
+    std::size_t nodes = numa_topology::system().node_count();
+    std::cout << nodes << " NUMA node(s), " << job_count << " jobs of " << width << "x" << height
+              << " -> " << new_width << "x" << new_height << ", best of " << repeats << std::endl;
+    std::cout << std::left << std::setw(12) << "placement" << std::setw(12) << "images/s" << "MB/s touched" << std::endl;
+
+    struct placement {
+        const char* name;
+        bool pinned;
+        std::size_t touch_offset;
+    };
+    for (const placement& mode : {placement{"unpinned", false, 0}, placement{"cross-node", true, 1}, placement{"node-local", true, 0}}) {
+        task_scheduler scheduler(threads, mode.pinned);
+        std::vector<job_buffers> jobs(job_count);
+        double best = 0.0;
+        for (int i = 0; i < repeats; ++i) {
+            for (std::size_t j = 0; j < job_count; ++j) {
+                place(jobs[j], pattern, new_width, new_height, mode.pinned, (j + mode.touch_offset) % scheduler.node_count());
+            }
+            double seconds = run(*resizer, jobs, scheduler, mode.pinned);
+            best = i == 0 ? seconds : std::min(best, seconds);
+        }
+        std::cout << std::left << std::setw(12) << mode.name << std::fixed << std::setprecision(1)
+                  << std::setw(12) << job_count / best << megabytes / best << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Measures interactive resize latency while bulk resizes saturate the scheduler.
+//
+// Bulk jobs halve a large image over and over; interactive requests turn a small image
+// into a thumbnail at a fixed rate and record the time from submission to completion.
+// Three scenarios are compared:
+//   idle         interactive requests alone
+//   one class    bulk jobs submitted as interactive (the scheduler before priority classes)
+//   two classes  bulk jobs submitted as bulk, with the given bulk share
+//
+// Usage: bench_priority_latency [requests] [interval_ms] [bulk_jobs] [threads] [bulk_share]
+// Defaults: 200 requests every 5 ms, two bulk jobs per worker, all cores, bulk share 0.
+
+#include "CImg.h"
+#include "resizer_factory.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace cimg_library;
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+CImg<unsigned char> pattern(int width, int height) {
+    CImg<unsigned char> image(width, height, 1, 3);
+    cimg_forXYC(image, x, y, c) {
+        image(x, y, 0, c) = static_cast<unsigned char>((x * 7 + y * 3 + c * 85) & 0xFF);
+    }
+    return image;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size()));
+    return values[index];
+}
+
+/**
+ * @brief Runs the interactive requests, with bulk_jobs bulk resizes looping in the background.
+ *
+ * @return std::vector<double> Request latencies in milliseconds.
+ */
+std::vector<double> run(task_scheduler& scheduler, const resize_image_base& resizer, int requests, int interval_ms,
+                        std::size_t bulk_jobs, task_priority bulk_priority) {
+    const CImg<unsigned char> bulk_source = pattern(4096, 4096);
+    const CImg<unsigned char> request_source = pattern(512, 512);
+
+    std::atomic<bool> stop(false);
+    std::vector<CImg<unsigned char>> bulk_results(bulk_jobs, CImg<unsigned char>(2048, 2048, 1, 3));
+    std::function<void(std::size_t)> bulk_job = [&](std::size_t job) {
+        resizer.resize_parallel(bulk_source, bulk_results[job], scheduler);
+        if (!stop) {
+            scheduler.submit([&bulk_job, job] { bulk_job(job); }, bulk_priority);
+        }
+    };
+    for (std::size_t job = 0; job < bulk_jobs; ++job) {
+        scheduler.submit([&bulk_job, job] { bulk_job(job); }, bulk_priority);
+    }
+
+    std::mutex latencies_mutex;
+    std::vector<double> latencies;
+    std::vector<CImg<unsigned char>> thumbnails(requests, CImg<unsigned char>(128, 128, 1, 3));
+    auto next = bench_clock::now();
+    for (int i = 0; i < requests; ++i) {
+        std::this_thread::sleep_until(next);
+        next += std::chrono::milliseconds(interval_ms);
+        auto submitted = bench_clock::now();
+        scheduler.submit([&, i, submitted] {
+            resizer.resize_parallel(request_source, thumbnails[i], scheduler);
+            double ms = std::chrono::duration<double, std::milli>(bench_clock::now() - submitted).count();
+            std::lock_guard<std::mutex> lock(latencies_mutex);
+            latencies.push_back(ms);
+        }, task_priority::interactive);
+    }
+
+    stop = true;
+    scheduler.wait_idle();
+    return latencies;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int requests = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+    int interval_ms = argc > 2 ? std::max(0, std::atoi(argv[2])) : 5;
+    std::size_t bulk_jobs = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    std::size_t threads = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+    double bulk_share = argc > 5 ? std::atof(argv[5]) : 0.0;
+
+    std::unique_ptr<resize_image_base> resizer = create_resizer("bilinear");
+    task_scheduler scheduler(threads);
+    scheduler.set_bulk_share(bulk_share);
+    if (bulk_jobs == 0) {
+        bulk_jobs = 2 * scheduler.size();
+    }
+
+    std::cout << requests << " thumbnail requests (512x512 -> 128x128) every " << interval_ms << " ms, "
+              << bulk_jobs << " bulk jobs (4096x4096 -> 2048x2048), " << scheduler.size()
+              << " threads, bulk share " << bulk_share << std::endl;
+    std::cout << std::left << std::setw(14) << "scenario" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+              << "max ms" << std::endl;
+
+    struct scenario {
+        const char* name;
+        std::size_t bulk_jobs;
+        task_priority bulk_priority;
+    };
+    for (const scenario& mode : {scenario{"idle", 0, task_priority::bulk},
+                                 scenario{"one class", bulk_jobs, task_priority::interactive},
+                                 scenario{"two classes", bulk_jobs, task_priority::bulk}}) {
+        std::vector<double> latencies = run(scheduler, *resizer, requests, interval_ms, mode.bulk_jobs, mode.bulk_priority);
+        std::cout << std::left << std::setw(14) << mode.name << std::fixed << std::setprecision(2)
+                  << std::setw(10) << percentile(latencies, 0.5) << std::setw(10) << percentile(latencies, 0.99)
+                  << *std::max_element(latencies.begin(), latencies.end()) << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Compares the row-band and tile partitionings of resize_image_base::resize_parallel()
+// on a synthetic wide panorama.
+//
+// Usage: bench_resize_modes [width] [height] [threads] [repeats]
+// Defaults: a 16384 x 2048 RGB panorama, all cores, 3 repeats (best time is reported).
+
+#include "CImg.h"
+#include "resizer_factory.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace cimg_library;
+
+namespace {
+
+double best_seconds(const resize_image_base& resizer, const CImg<unsigned char>& source, CImg<unsigned char>& result,
+                    task_scheduler& scheduler, parallel_mode mode, int repeats) {
+    double best = 0.0;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        resizer.resize_parallel(source, result, scheduler, mode);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = i == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 16384;
+    int height = argc > 2 ? std::atoi(argv[2]) : 2048;
+    std::size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    int repeats = argc > 4 ? std::max(1, std::atoi(argv[4])) : 3;
+
+    // Smooth gradients with some per-pixel noise, roughly like a photographic panorama
+    CImg<unsigned char> source(width, height, 1, 3);
+    unsigned state = 12345;
+    cimg_forXYC(source, x, y, c) {
+        state = state * 1103515245u + 12345u;
+        source(x, y, 0, c) = static_cast<unsigned char>((x / 64 + y / 16 + c * 85 + (state >> 28)) & 0xFF);
+    }
+
+    task_scheduler scheduler(threads);
+    std::cout << "Panorama " << width << "x" << height << " RGB, " << scheduler.size() << " threads, best of "
+              << repeats << std::endl;
+    std::cout << std::left << std::setw(10) << "method" << std::setw(8) << "scale" << std::setw(14) << "output"
+              << std::setw(14) << "bands ms" << std::setw(14) << "tiles ms" << "speedup" << std::endl;
+
+    bool identical = true;
+    for (const std::string& method : resizer_methods()) {
+        std::unique_ptr<resize_image_base> resizer = create_resizer(method);
+        for (float scale : {0.25f, 0.5f, 1.0f}) {
+            int new_width = std::max(1, static_cast<int>(width * scale));
+            int new_height = std::max(1, static_cast<int>(height * scale));
+            CImg<unsigned char> bands(new_width, new_height, 1, 3);
+            CImg<unsigned char> tiles(new_width, new_height, 1, 3);
+            double band_seconds = best_seconds(*resizer, source, bands, scheduler, parallel_mode::row_bands, repeats);
+            double tile_seconds = best_seconds(*resizer, source, tiles, scheduler, parallel_mode::tiles, repeats);
+            identical = identical && bands == tiles;
+
+            std::cout << std::left << std::setw(10) << method << std::setw(8) << scale
+                      << std::setw(14) << (std::to_string(new_width) + "x" + std::to_string(new_height))
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(14) << band_seconds * 1e3 << std::setw(14) << tile_seconds * 1e3
+                      << std::setprecision(2) << band_seconds / tile_seconds << "x" << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+    if (!identical) {
+        std::cerr << "error: row-band and tile outputs differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef ALIGNED_IMAGE_H
+#define ALIGNED_IMAGE_H
+
+#include "CImg.h"
+#include "image_view.h"
+#include <cstddef>
+
+/**
+ * @brief Owning planar 8-bit image with cache-line-aligned, padded rows.
+ *
+ * CImg packs rows tightly behind a plain new[], so a row starts at any alignment and a
+ * vector loop over it needs unaligned accesses and a scalar tail. Here every row of every
+ * channel starts on an image_row_alignment boundary and is padded to aligned_row_stride(width)
+ * samples, so kernels can process whole padded rows with aligned full-vector loads and
+ * stores. It converts implicitly to image_view and mutable_image_view, whose aligned_rows()
+ * then reports the guarantee. Large images are backed by huge_page_resource::shared(). Move-only.
+ */
+class aligned_image {
+public:
+    /**
+     * @brief Creates an empty image.
+     */
+    aligned_image() = default;
+
+    /**
+     * @brief Allocates an uninitialized image.
+     */
+    aligned_image(int width, int height, int channels);
+
+    /**
+     * @brief Copies a view of any layout into aligned storage.
+     */
+    explicit aligned_image(const image_view& source);
+
+    aligned_image(aligned_image&& other) noexcept;
+    aligned_image& operator=(aligned_image&& other) noexcept;
+    aligned_image(const aligned_image&) = delete;
+    aligned_image& operator=(const aligned_image&) = delete;
+    ~aligned_image();
+
+    int width() const { return image_width; }
+    int height() const { return image_height; }
+    int channels() const { return image_channels; }
+
+    /**
+     * @brief Returns the samples from one row to the next, a multiple of image_row_alignment.
+     */
+    std::ptrdiff_t row_stride() const { return stride; }
+
+    /**
+     * @brief Returns the size of the storage, padding included.
+     */
+    std::size_t bytes() const { return static_cast<std::size_t>(stride) * image_height * image_channels; }
+
+    unsigned char* data() { return pixels; }
+    const unsigned char* data() const { return pixels; }
+
+    mutable_image_view view() { return mutable_image_view::aligned(pixels, image_width, image_height, image_channels, stride); }
+    image_view view() const { return image_view::aligned(pixels, image_width, image_height, image_channels, stride); }
+    operator mutable_image_view() { return view(); }
+    operator image_view() const { return view(); }
+
+    /**
+     * @brief Copies the pixels into a tightly packed CImg, e.g. for CImg's file savers.
+     */
+    cimg_library::CImg<unsigned char> to_cimg() const;
+
+private:
+    unsigned char* pixels = nullptr;
+    int image_width = 0;
+    int image_height = 0;
+    int image_channels = 0;
+    std::ptrdiff_t stride = 0;
+};
+
+#endif // ALIGNED_IMAGE_H
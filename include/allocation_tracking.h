@@ -0,0 +1,120 @@
+#ifndef ALLOCATION_TRACKING_H
+#define ALLOCATION_TRACKING_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Receives the allocations and frees made while it is the current observer.
+ *
+ * Implementations are called from inside operator new and delete, so they must not allocate
+ * and must be thread-safe.
+ */
+class allocation_observer {
+public:
+    virtual ~allocation_observer() = default;
+    virtual void allocated(std::size_t bytes) = 0;
+    virtual void deallocated(std::size_t bytes) = 0;
+};
+
+/**
+ * @brief Makes an observer current on the calling thread while the scope is alive.
+ *
+ * The hook points report to the current observer: the global operator new and delete
+ * (which covers CImg images, containers and zlib state), huge_page_resource's own mappings,
+ * buffer_pool handing out and taking back recycled buffers, and arena allocations and resets.
+ * Work handed to other threads keeps its observer: task_scheduler tasks and encoder_pool
+ * writes run under the observer current when they were submitted. Scopes nest; a null
+ * observer stops tracking, e.g. for memory kept across jobs. A free is reported to the
+ * observer current where it happens, so a job's numbers balance when its memory is released
+ * within its own scopes.
+ */
+class allocation_scope {
+public:
+    explicit allocation_scope(allocation_observer* observer);
+    ~allocation_scope();
+
+    allocation_scope(const allocation_scope&) = delete;
+    allocation_scope& operator=(const allocation_scope&) = delete;
+
+    /**
+     * @brief Returns the calling thread's current observer, or nullptr.
+     */
+    static allocation_observer* current();
+
+private:
+    allocation_observer* previous;
+};
+
+/**
+ * @brief Reports an allocation that bypasses operator new (e.g. mmap) to the current observer.
+ */
+void note_allocation(std::size_t bytes);
+
+/**
+ * @brief Reports the matching free to the current observer.
+ */
+void note_deallocation(std::size_t bytes);
+
+/**
+ * @brief Allocation counters of one phase of a job, or of the whole job.
+ */
+struct allocation_counters {
+    unsigned long long bytes = 0;  ///< Bytes allocated.
+    std::size_t count = 0;         ///< Allocations made.
+    std::size_t peak_bytes = 0;    ///< Highest live bytes of the job seen by this phase's allocations.
+};
+
+/**
+ * @brief Allocation counters of a job, in total and per phase.
+ */
+struct job_allocation_stats {
+    allocation_counters total;
+    allocation_counters decode;
+    allocation_counters resize;  ///< Outputs and resize intermediates.
+    allocation_counters encode;
+};
+
+/**
+ * @brief Stage of a job that an allocation is charged to.
+ */
+enum class allocation_phase { decode, resize, encode };
+
+/**
+ * @brief allocation_observer set of one job: one observer per phase sharing the job's live bytes.
+ */
+class job_allocations {
+public:
+    job_allocations();
+
+    job_allocations(const job_allocations&) = delete;
+    job_allocations& operator=(const job_allocations&) = delete;
+
+    /**
+     * @brief Returns the observer charging allocations to a phase; open an allocation_scope with it.
+     */
+    allocation_observer* phase(allocation_phase phase) { return &phases[static_cast<int>(phase)]; }
+
+    /**
+     * @brief Returns the counters so far.
+     */
+    job_allocation_stats stats() const;
+
+private:
+    class phase_observer : public allocation_observer {
+    public:
+        job_allocations* job = nullptr;
+        std::atomic<unsigned long long> bytes{0};
+        std::atomic<std::size_t> count{0};
+        std::atomic<std::size_t> peak{0};
+
+        void allocated(std::size_t size) override;
+        void deallocated(std::size_t size) override;
+    };
+
+    std::atomic<long long> live{0};
+    std::atomic<std::size_t> peak{0};
+    phase_observer phases[3];
+};
+
+#endif // ALLOCATION_TRACKING_H
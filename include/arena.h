@@ -0,0 +1,86 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "CImg.h"
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Allocation counters of an arena.
+ */
+struct arena_stats {
+    std::size_t allocations = 0;         ///< Requests served, each a heap allocation without the arena.
+    unsigned long long bytes = 0;        ///< Bytes requested in total.
+    std::size_t blocks = 0;              ///< Heap allocations the arena itself made.
+    unsigned long long block_bytes = 0;  ///< Bytes held in blocks.
+    std::size_t resets = 0;              ///< Calls to reset().
+
+    arena_stats& operator+=(const arena_stats& other);
+};
+
+/**
+ * @brief Monotonic memory resource whose memory is reclaimed all at once by reset().
+ *
+ * Allocation bumps a pointer through a list of large blocks and deallocation does nothing;
+ * reset() rewinds to the first block in O(1) and keeps every block for the next round, so
+ * a worker that resets its arena after each image stops touching the heap once the blocks
+ * cover its largest image. Use it through std::pmr containers for scratch that lives no
+ * longer than one job. Thread-safe, so the bands of one resize can share an arena.
+ */
+class arena : public std::pmr::memory_resource {
+public:
+    /**
+     * @brief Creates an empty arena; no memory is reserved until the first allocation.
+     *
+     * @param block_size Size of each block; larger requests get a block of their own size.
+     */
+    explicit arena(std::size_t block_size = 1 << 20);
+
+    /**
+     * @brief Frees every block.
+     */
+    ~arena() override;
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    /**
+     * @brief Makes all memory available again; everything allocated so far becomes invalid.
+     */
+    void reset();
+
+    /**
+     * @brief Returns the counters accumulated since construction.
+     */
+    arena_stats stats() const;
+
+    /**
+     * @brief Allocates an uninitialized image whose pixels live in the arena.
+     *
+     * The image is a shared CImg: it never frees its buffer, and assigning a different size
+     * to it throws. It is valid until the next reset().
+     */
+    cimg_library::CImg<unsigned char> image(int width, int height, int channels);
+
+private:
+    struct block {
+        unsigned char* data;
+        std::size_t size;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::size_t block_size;
+    std::vector<block> blocks;
+    std::size_t current = 0;
+    std::size_t offset = 0;
+    std::size_t handed_out = 0;
+    arena_stats counters;
+    mutable std::mutex mutex;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,245 @@
+#ifndef ASYNC_RESULT_H
+#define ASYNC_RESULT_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief Executor that runs a continuation directly on the thread completing the previous stage.
+ *
+ * Any type with a submit(std::function<void()>) member can be used as an executor; a
+ * task_scheduler is the usual choice.
+ */
+struct inline_executor {
+    void submit(std::function<void()> task) { task(); }
+};
+
+template <typename T>
+class async_result;
+
+namespace async_detail {
+
+template <typename T>
+using stored_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+/**
+ * @brief State shared by an async_promise and the async_result it completes.
+ */
+template <typename T>
+struct async_state {
+    std::mutex mutex;
+    std::condition_variable done;
+    bool ready = false;
+    std::optional<stored_t<T>> value;
+    std::exception_ptr error;
+    std::vector<std::function<void()>> callbacks;
+
+    void complete() {
+        std::vector<std::function<void()>> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready = true;
+            pending.swap(callbacks);
+        }
+        done.notify_all();
+        for (std::function<void()>& callback : pending) {
+            callback();
+        }
+    }
+
+    // Runs callback once the state is ready, immediately if it already is
+    void when_ready(std::function<void()> callback) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ready) {
+                callbacks.push_back(std::move(callback));
+                return;
+            }
+        }
+        callback();
+    }
+};
+
+} // namespace async_detail
+
+/**
+ * @brief Producer side of an async_result; sets its value or exception exactly once.
+ *
+ * @tparam T The value type, or void.
+ */
+template <typename T>
+class async_promise {
+public:
+    async_promise() : state(std::make_shared<async_detail::async_state<T>>()) {}
+
+    /**
+     * @brief Returns the result completed by this promise.
+     */
+    async_result<T> result() const { return async_result<T>(state); }
+
+    /**
+     * @brief Completes the result with a value.
+     */
+    template <typename U = T, typename = std::enable_if_t<!std::is_void_v<U>>>
+    void set_value(U value) {
+        state->value.emplace(std::move(value));
+        state->complete();
+    }
+
+    /**
+     * @brief Completes a void result.
+     */
+    template <typename U = T, typename = std::enable_if_t<std::is_void_v<U>>>
+    void set_value() {
+        state->value.emplace();
+        state->complete();
+    }
+
+    /**
+     * @brief Completes the result with an exception, rethrown by async_result::get().
+     */
+    void set_exception(std::exception_ptr error) {
+        state->error = std::move(error);
+        state->complete();
+    }
+
+private:
+    std::shared_ptr<async_detail::async_state<T>> state;
+};
+
+/**
+ * @brief The eventual value of an asynchronous operation, with continuations.
+ *
+ * Unlike std::future, a result can chain further stages with then(), each on an executor of
+ * the caller's choice, so resize, encode and write can run on different pools without any
+ * thread blocking in between. An exception thrown by a stage skips the remaining then()
+ * stages and is rethrown by get() on the final result. A result has a single consumer: call
+ * get(), then() or on_complete() once.
+ *
+ * @tparam T The value type, or void.
+ */
+template <typename T>
+class async_result {
+public:
+    /**
+     * @brief Creates an empty result that is not attached to any operation.
+     */
+    async_result() = default;
+
+    /**
+     * @brief Returns whether the result is attached to an operation.
+     */
+    bool valid() const { return state != nullptr; }
+
+    /**
+     * @brief Returns whether the operation has finished.
+     */
+    bool ready() const {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->ready;
+    }
+
+    /**
+     * @brief Blocks until the operation has finished.
+     */
+    void wait() const {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [this] { return state->ready; });
+    }
+
+    /**
+     * @brief Waits for the operation and returns its value.
+     *
+     * @return T The value, moved out of the result.
+     * @throws Whatever the operation or an earlier stage threw.
+     */
+    T get() {
+        wait();
+        std::shared_ptr<async_detail::async_state<T>> finished = std::move(state);
+        if (finished->error) {
+            std::rethrow_exception(finished->error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*finished->value);
+        }
+    }
+
+    /**
+     * @brief Chains a stage that runs on an executor once this result has a value.
+     *
+     * @param executor Runs the continuation; it must outlive the chain.
+     * @param continuation Called with the value (or with no argument for void results).
+     * @return async_result The continuation's return value, or the first exception of the chain.
+     */
+    template <typename Executor, typename F>
+    auto then(Executor& executor, F continuation) {
+        using next_type = std::conditional_t<std::is_void_v<T>, std::invoke_result<F>, std::invoke_result<F, T>>;
+        using U = typename next_type::type;
+        async_promise<U> next;
+        async_result<U> next_result = next.result();
+        std::shared_ptr<async_detail::async_state<T>> previous = std::move(state);
+        previous->when_ready([previous, next, &executor, continuation = std::move(continuation)]() mutable {
+            if (previous->error) {
+                next.set_exception(previous->error);
+                return;
+            }
+            executor.submit([previous, next, continuation = std::move(continuation)]() mutable {
+                try {
+                    if constexpr (std::is_void_v<T> && std::is_void_v<U>) {
+                        continuation();
+                        next.set_value();
+                    } else if constexpr (std::is_void_v<T>) {
+                        next.set_value(continuation());
+                    } else if constexpr (std::is_void_v<U>) {
+                        continuation(std::move(*previous->value));
+                        next.set_value();
+                    } else {
+                        next.set_value(continuation(std::move(*previous->value)));
+                    }
+                } catch (...) {
+                    next.set_exception(std::current_exception());
+                }
+            });
+        });
+        return next_result;
+    }
+
+    /**
+     * @brief Registers a callback run on an executor once the operation has finished.
+     *
+     * The callback receives the finished result and calls get() on it to obtain the value or
+     * the exception; get() does not block there.
+     *
+     * @param executor Runs the callback; it must outlive the operation.
+     * @param callback Called as callback(async_result<T>).
+     */
+    template <typename Executor, typename F>
+    void on_complete(Executor& executor, F callback) {
+        std::shared_ptr<async_detail::async_state<T>> finished = std::move(state);
+        finished->when_ready([finished, &executor, callback = std::move(callback)]() mutable {
+            executor.submit([finished, callback = std::move(callback)]() mutable {
+                callback(async_result<T>(finished));
+            });
+        });
+    }
+
+private:
+    template <typename>
+    friend class async_promise;
+    template <typename>
+    friend class async_result;
+
+    explicit async_result(std::shared_ptr<async_detail::async_state<T>> state) : state(std::move(state)) {}
+
+    std::shared_ptr<async_detail::async_state<T>> state;
+};
+
+#endif // ASYNC_RESULT_H
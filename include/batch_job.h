@@ -0,0 +1,102 @@
+#ifndef BATCH_JOB_H
+#define BATCH_JOB_H
+
+#include "png_writer.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Largest output width or height size_spec::resolve() accepts.
+ */
+constexpr int max_output_dimension = 1 << 20;
+
+/**
+ * @brief Target size of a resize job, either absolute or relative to the source.
+ *
+ * Accepted spellings are "WxH", "Wx" or "xH" (the missing side keeps the aspect ratio),
+ * a plain scale factor such as "0.5", or a percentage such as "50%".
+ */
+struct size_spec {
+    float scale = 0.0f;
+    int width = 0;
+    int height = 0;
+    std::string label;
+
+    /**
+     * @brief Parses a size specification.
+     *
+     * @param text The specification text.
+     * @return size_spec The parsed specification.
+     * @throws std::invalid_argument If the text is not a valid specification.
+     */
+    static size_spec parse(const std::string& text);
+
+    /**
+     * @brief Computes the output dimensions for a source of the given size.
+     *
+     * @param source_width The width of the source image.
+     * @param source_height The height of the source image.
+     * @param new_width Receives the output width (at least 1).
+     * @param new_height Receives the output height (at least 1).
+     * @throws std::invalid_argument If a side would exceed max_output_dimension.
+     */
+    void resolve(int source_width, int source_height, int& new_width, int& new_height) const;
+};
+
+/**
+ * @brief One output of a batch: which file to read, how to resize it and where to write it.
+ */
+struct resize_job {
+    std::string input;
+    std::string output;
+    size_spec size;
+    std::string method;
+    png_options png;
+};
+
+/**
+ * @brief Applies a per-job "key=value" option ("png-level=N" or "png-filter=NAME").
+ *
+ * @param option The option text.
+ * @param job The job to update.
+ * @throws std::invalid_argument If the key is unknown or the value invalid.
+ */
+void apply_job_option(const std::string& option, resize_job& job);
+
+/**
+ * @brief Reads jobs from a manifest file.
+ *
+ * Each non-empty line holds four whitespace-separated fields: input path, output path,
+ * size specification and method name, optionally followed by per-job PNG settings
+ * "png-level=N" and "png-filter=NAME". Text after '#' is ignored.
+ *
+ * @param path The manifest file.
+ * @param png_defaults PNG settings for lines that do not override them.
+ * @return std::vector<resize_job> The jobs in file order.
+ * @throws std::runtime_error If the file cannot be read or a line is malformed.
+ */
+std::vector<resize_job> load_manifest(const std::string& path, const png_options& png_defaults = png_options());
+
+/**
+ * @brief Expands command-line inputs into a list of image files.
+ *
+ * Directories contribute their image files (non-recursive, sorted by name), glob patterns
+ * are expanded with glob(3), and anything else is taken as a file path.
+ *
+ * @param inputs The inputs as given on the command line.
+ * @return std::vector<std::string> The image files, in input order.
+ */
+std::vector<std::string> expand_inputs(const std::vector<std::string>& inputs);
+
+/**
+ * @brief Builds the default output path "<dir>/<stem>_resized_<method>_<size>.png".
+ *
+ * @param output_dir The output directory.
+ * @param input The input file path.
+ * @param method The resizing method name.
+ * @param size The target size; its label is used in the file name.
+ * @return std::string The output path.
+ */
+std::string default_output_path(const std::string& output_dir, const std::string& input, const std::string& method, const size_spec& size);
+
+#endif // BATCH_JOB_H
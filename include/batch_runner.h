@@ -0,0 +1,143 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "allocation_tracking.h"
+#include "arena.h"
+#include "batch_job.h"
+#include "buffer_pool.h"
+#include "huge_pages.h"
+#include "memory_budget.h"
+#include "cancellation_token.h"
+#include "tiled_tiff.h"
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Load of one pipeline stage over a batch run.
+ */
+struct stage_stats {
+    std::size_t threads = 0;
+    std::size_t items = 0;
+    double busy_seconds = 0.0;
+
+    /**
+     * @brief Returns the fraction of the stage's thread time spent working, from 0 to 1.
+     *
+     * @param wall_seconds The wall time of the run.
+     */
+    double utilization(double wall_seconds) const;
+};
+
+/**
+ * @brief Allocation counters of one input and all its outputs.
+ */
+struct input_allocation_stats {
+    std::string input;  ///< The input path; "input -> output" for a TIFF job.
+    job_allocation_stats allocations;
+};
+
+/**
+ * @brief Outcome counters and timings of one batch run.
+ */
+struct batch_stats {
+    std::size_t jobs = 0;
+    std::size_t succeeded = 0;
+    std::size_t failed = 0;
+    std::size_t cancelled = 0;
+    std::size_t images_decoded = 0;
+    unsigned long long input_pixels = 0;
+    unsigned long long output_pixels = 0;
+    double wall_seconds = 0.0;
+    stage_stats decode;
+    stage_stats resize;
+    stage_stats encode;
+    arena_stats scratch;
+    buffer_pool_stats output_buffers;
+    huge_page_stats huge_pages;
+    memory_budget_stats memory;
+    unsigned long long pixel_bytes_copied = 0;               ///< Pixel bytes in explicit copies (see pixel_copy_scope), all jobs.
+    std::size_t jobs_copying = 0;                            ///< Jobs that copied any pixels.
+    std::vector<unsigned long long> job_pixel_bytes_copied;  ///< Per job, in job order; only with debug_stats.
+    job_allocation_stats allocations;                        ///< Summed over inputs; peaks are the largest of any input.
+    std::vector<input_allocation_stats> input_allocations;   ///< Per input, in job order; only with debug_stats.
+    std::vector<std::string> errors;
+    std::vector<std::string> plans;
+
+    /**
+     * @brief Returns successfully written outputs per second of wall time.
+     */
+    double images_per_second() const;
+
+    /**
+     * @brief Returns output megapixels written per second of wall time.
+     */
+    double megapixels_per_second() const;
+
+    /**
+     * @brief Prints a human-readable summary, including every error and recorded plan.
+     */
+    void print_summary(std::ostream& out) const;
+
+    /**
+     * @brief Writes the statistics as a single JSON object.
+     */
+    void write_json(std::ostream& out) const;
+};
+
+/**
+ * @brief Tuning knobs of a batch run.
+ */
+struct batch_options {
+    std::size_t decoders = 2;                                ///< Decoder threads.
+    std::size_t decode_queue = 4;                            ///< Decoded inputs waiting to be resized, per NUMA node.
+    std::size_t workers = 0;                                 ///< Resize workers; zero selects the hardware concurrency.
+    std::size_t encoders = 2;                                ///< Encoder threads.
+    std::size_t encode_queue = 8;                            ///< Outputs waiting to be written.
+    std::size_t output_pool_bytes = std::size_t(256) << 20;  ///< Most memory the output buffer_pool keeps for reuse.
+    bool in_place = false;                                   ///< Resize a lone downscaled output inside its input (resize_inplace()).
+    std::size_t memory_budget_bytes = 0;                     ///< Estimated peak bytes of inputs in flight; decoders wait above it. Zero for no limit.
+    bool numa = false;                                       ///< Pin threads per NUMA node and resize each input on the node that decoded it.
+    std::chrono::milliseconds job_deadline{0};               ///< Per-input deadline from the start of its decode; zero for none.
+    bool debug_stats = false;                                ///< Record per-input plans, copies and allocations in the statistics.
+    cancellation_token cancel;                               ///< Cancels the whole batch; written outputs stay.
+    tiled_resize_options tiled;                              ///< Tiling of TIFF inputs.
+    std::ostream* log = nullptr;                             ///< Receives one line per written output, or nullptr.
+};
+
+/**
+ * @brief Runs resize jobs as a three-stage decode, resize and encode pipeline.
+ *
+ * Decoder threads load the inputs, the task_scheduler workers resize them and an
+ * encoder_pool writes the outputs; bounded queues between the stages keep the number of
+ * images in memory bounded. Jobs sharing an input are resized together from a single
+ * decode. TIFF inputs are resized tile by tile with resize_tiled() and never decoded whole.
+ * A failing job is recorded in the statistics and does not affect the other jobs.
+ */
+class batch_runner {
+public:
+    /**
+     * @brief Creates a runner.
+     *
+     * @param options Decoder, worker and encoder counts (zero workers selects the hardware
+     *                concurrency), queue capacities, NUMA pinning, the per-input deadline
+     *                (zero for none), a token cancelling the whole batch and the stream
+     *                receiving one line per written output.
+     */
+    explicit batch_runner(const batch_options& options = batch_options());
+
+    /**
+     * @brief Runs all jobs and waits for them to finish.
+     *
+     * @param jobs The jobs to run.
+     * @return batch_stats The counters and timings of the run.
+     */
+    batch_stats run(const std::vector<resize_job>& jobs);
+
+private:
+    batch_options options;
+};
+
+#endif // BATCH_RUNNER_H
@@ -0,0 +1,200 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Fixed-capacity multi-producer multi-consumer queue connecting pipeline stages.
+ *
+ * try_push() and try_pop() are lock-free: every cell carries a sequence number that tells
+ * producers and consumers whether it is free or filled for their lap of the ring (Vyukov's
+ * bounded MPMC queue). The blocking push() and pop() spin briefly and then park on a
+ * condition variable, which is only touched when a stage actually has to wait. Because the
+ * capacity is fixed, a full queue stalls its producers, so a slow stage throttles the
+ * stages before it instead of letting buffered images pile up.
+ *
+ * @tparam T The element type; it must be default-constructible and movable.
+ */
+template <typename T>
+class bounded_queue {
+public:
+    /**
+     * @brief Creates an empty queue.
+     *
+     * @param capacity Maximum number of queued elements. At least two cells are used, since
+     *                 with a single cell the sequence numbers of "full" and "free for the next
+     *                 lap" would coincide.
+     */
+    explicit bounded_queue(std::size_t capacity)
+        : slots(std::max<std::size_t>(capacity, 2)), cells(new cell[slots]) {
+        for (std::size_t i = 0; i < slots; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    /**
+     * @brief Appends an element if there is room.
+     *
+     * @param value The element; it is moved from only on success.
+     * @return bool False if the queue was full.
+     */
+    bool try_push(T& value) {
+        if (!enqueue(value)) {
+            return false;
+        }
+        wake(not_empty);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest element if there is one.
+     *
+     * @param value Receives the element.
+     * @return bool False if the queue was empty.
+     */
+    bool try_pop(T& value) {
+        if (!dequeue(value)) {
+            return false;
+        }
+        wake(not_full);
+        return true;
+    }
+
+    /**
+     * @brief Appends an element, blocking while the queue is full.
+     *
+     * @param value The element to move into the queue.
+     */
+    void push(T value) {
+        wait_until(not_full, [&] { return enqueue(value); });
+        wake(not_empty);
+    }
+
+    /**
+     * @brief Removes the oldest element, blocking while the queue is empty and open.
+     *
+     * @param value Receives the element.
+     * @return bool False once the queue is closed and drained.
+     */
+    bool pop(T& value) {
+        bool popped = false;
+        wait_until(not_empty, [&] {
+            popped = dequeue(value);
+            return popped || closed.load();
+        });
+        // A push may have landed between the failed pop and the closed check
+        if (popped || dequeue(value)) {
+            wake(not_full);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Marks the end of the input; pop() returns false once the remaining elements are taken.
+     */
+    void close() {
+        closed.store(true);
+        std::lock_guard<std::mutex> lock(park_mutex);
+        not_empty.notify_all();
+    }
+
+    /**
+     * @brief Returns the maximum number of queued elements.
+     */
+    std::size_t capacity() const { return slots; }
+
+private:
+    struct cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    // Lock-free cores of try_push() and try_pop(); they never touch the parking mutex
+    bool enqueue(T& value) {
+        std::size_t position = enqueue_position.load(std::memory_order_relaxed);
+        for (;;) {
+            cell& slot = cells[position % slots];
+            std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == position) {
+                if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position) {
+                return false;
+            } else {
+                position = enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool dequeue(T& value) {
+        std::size_t position = dequeue_position.load(std::memory_order_relaxed);
+        for (;;) {
+            cell& slot = cells[position % slots];
+            std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == position + 1) {
+                if (dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    slot.value = T();
+                    slot.sequence.store(position + slots, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position + 1) {
+                return false;
+            } else {
+                position = dequeue_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template <typename Ready>
+    void wait_until(std::condition_variable& condition, Ready ready) {
+        for (int spin = 0; spin < 64; ++spin) {
+            if (ready()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(park_mutex);
+        // Counting ourselves before the last check means a concurrent wake() sees us
+        ++parked;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!ready()) {
+            condition.wait(lock);
+        }
+        --parked;
+    }
+
+    void wake(std::condition_variable& condition) {
+        // Pairs with the fence in wait_until(): either the waiter sees our element or we see the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load() > 0) {
+            std::lock_guard<std::mutex> lock(park_mutex);
+            condition.notify_all();
+        }
+    }
+
+    const std::size_t slots;
+    std::unique_ptr<cell[]> cells;
+    alignas(64) std::atomic<std::size_t> enqueue_position{0};
+    alignas(64) std::atomic<std::size_t> dequeue_position{0};
+    std::atomic<bool> closed{false};
+    std::atomic<int> parked{0};
+    std::mutex park_mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+#endif // BOUNDED_QUEUE_H
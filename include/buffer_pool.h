@@ -0,0 +1,136 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include "image_view.h"
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class buffer_pool;
+
+/**
+ * @brief Counters of a buffer_pool.
+ */
+struct buffer_pool_stats {
+    std::size_t hits = 0;                    ///< Requests served by a recycled buffer.
+    std::size_t misses = 0;                  ///< Requests that allocated a new buffer.
+    std::size_t dropped = 0;                 ///< Returned buffers freed because the pool was at its cap.
+    std::size_t retained_bytes = 0;          ///< Bytes currently held for reuse.
+    std::size_t peak_retained_bytes = 0;     ///< Highest retained_bytes so far.
+    std::size_t max_retained_bytes = 0;      ///< The pool's high-water cap.
+};
+
+/**
+ * @brief Move-only handle to a buffer from a buffer_pool; returns it to the pool when destroyed.
+ */
+class pooled_buffer {
+public:
+    /**
+     * @brief Creates an empty handle.
+     */
+    pooled_buffer() = default;
+
+    pooled_buffer(pooled_buffer&& other) noexcept;
+    pooled_buffer& operator=(pooled_buffer&& other) noexcept;
+    pooled_buffer(const pooled_buffer&) = delete;
+    pooled_buffer& operator=(const pooled_buffer&) = delete;
+
+    /**
+     * @brief Returns the buffer to its pool.
+     */
+    ~pooled_buffer() { release(); }
+
+    /**
+     * @brief Returns the buffer to its pool now; the handle becomes empty.
+     */
+    void release();
+
+    unsigned char* data() const { return bytes; }
+
+    /**
+     * @brief Returns the usable size, which is the bucket size and at least the requested size.
+     */
+    std::size_t capacity() const { return bucket; }
+
+private:
+    friend class buffer_pool;
+
+    pooled_buffer(buffer_pool* pool, unsigned char* bytes, std::size_t bucket) : pool(pool), bytes(bytes), bucket(bucket) {}
+
+    buffer_pool* pool = nullptr;
+    unsigned char* bytes = nullptr;
+    std::size_t bucket = 0;
+};
+
+/**
+ * @brief An image whose pixels live in a pooled buffer.
+ *
+ * pixels views buffer as planar storage with aligned, padded rows (see aligned_image), so
+ * kernels writing into it can use full-vector stores for every row. Moving the struct keeps
+ * the two together; destroying it returns the pixels to the pool.
+ */
+struct pooled_image {
+    pooled_buffer buffer;
+    mutable_image_view pixels;
+};
+
+/**
+ * @brief Thread-safe pool of byte buffers, recycled by size bucket.
+ *
+ * Requests are rounded up to a bucket (quarter steps between powers of two, so at most 25%
+ * is wasted) and served from the buffers returned in that bucket, so a workload producing
+ * the same few output sizes stops allocating after warm-up. Buffers are aligned to
+ * image_row_alignment. Returned buffers are kept up to
+ * a high-water cap of retained bytes; beyond it they are freed. Contents of a recycled
+ * buffer are whatever its previous user left there. The pool must outlive its buffers.
+ */
+class buffer_pool {
+public:
+    /**
+     * @brief Creates an empty pool.
+     *
+     * @param max_retained_bytes Most bytes kept for reuse at any time.
+     */
+    explicit buffer_pool(std::size_t max_retained_bytes = std::size_t(256) << 20);
+
+    /**
+     * @brief Frees the retained buffers.
+     */
+    ~buffer_pool();
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    /**
+     * @brief Returns a buffer of at least the given size.
+     */
+    pooled_buffer acquire(std::size_t bytes);
+
+    /**
+     * @brief Returns an uninitialized planar image with aligned rows, backed by a pooled buffer.
+     */
+    pooled_image image(int width, int height, int channels);
+
+    /**
+     * @brief Returns the hit, miss and retention counters.
+     */
+    buffer_pool_stats stats() const;
+
+    /**
+     * @brief Returns the bucket a request of the given size is served from.
+     */
+    static std::size_t bucket_size(std::size_t bytes);
+
+private:
+    friend class pooled_buffer;
+
+    void give_back(unsigned char* bytes, std::size_t bucket);
+
+    std::map<std::size_t, std::vector<unsigned char*>> free_buffers;
+    buffer_pool_stats counters;
+    mutable std::mutex mutex;
+};
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,82 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+/**
+ * @brief Thrown by long-running operations that stop early because their token was cancelled.
+ */
+class operation_cancelled : public std::runtime_error {
+public:
+    operation_cancelled() : std::runtime_error("operation cancelled") {}
+};
+
+/**
+ * @brief Cooperative cancellation flag with an optional deadline, shared by copies.
+ *
+ * Kernels poll is_cancelled() at row-band granularity: the check is one relaxed atomic load
+ * per token in the chain, plus a clock read only when a deadline is set. A default-constructed
+ * token can never be cancelled and costs a null check. Cancelling is safe from any thread and
+ * from a signal handler.
+ */
+class cancellation_token {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Creates a token that is never cancelled.
+     */
+    cancellation_token() = default;
+
+    /**
+     * @brief Creates a token that is cancelled only by cancel().
+     */
+    static cancellation_token create();
+
+    /**
+     * @brief Creates a token that is cancelled by cancel() or once a deadline passes.
+     *
+     * @param deadline The point in time after which the token counts as cancelled.
+     */
+    static cancellation_token with_deadline(clock::time_point deadline);
+
+    /**
+     * @brief Creates a token cancelled together with this one, or after a timeout from now.
+     *
+     * @param timeout Time until the child expires; zero or negative means no deadline of its own.
+     */
+    cancellation_token child(clock::duration timeout = clock::duration::zero()) const;
+
+    /**
+     * @brief Cancels this token and its children; does nothing on a default-constructed token.
+     */
+    void cancel() const;
+
+    /**
+     * @brief Returns whether this token or one of its parents was cancelled or has expired.
+     */
+    bool is_cancelled() const;
+
+    /**
+     * @brief Throws operation_cancelled if is_cancelled().
+     */
+    void throw_if_cancelled() const {
+        if (is_cancelled()) {
+            throw operation_cancelled();
+        }
+    }
+
+private:
+    struct state {
+        std::atomic<bool> cancelled{false};
+        clock::time_point deadline = clock::time_point::max();
+        std::shared_ptr<const state> parent;
+    };
+
+    std::shared_ptr<state> shared;
+};
+
+#endif // CANCELLATION_TOKEN_H
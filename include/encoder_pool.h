@@ -0,0 +1,144 @@
+#ifndef ENCODER_POOL_H
+#define ENCODER_POOL_H
+
+#include "CImg.h"
+#include "allocation_tracking.h"
+#include "bounded_queue.h"
+#include "buffer_pool.h"
+#include "memory_budget.h"
+#include "png_writer.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A write that failed in the encoder pool.
+ */
+struct encode_failure {
+    std::size_t tag;
+    std::string path;
+    std::string message;
+};
+
+/**
+ * @brief Write-behind stage that encodes and saves images on its own threads.
+ *
+ * Finished images are handed over by move into a lock-free bounded_queue, so the resizing
+ * thread continues as soon as there is room; when the queue is full, submit() blocks until
+ * an encoder frees a slot, which keeps the number of buffered images bounded. Failures are
+ * collected and returned by flush() at the end of the batch. An image is written and freed
+ * under the allocation_scope that was current when it was submitted.
+ */
+class encoder_pool {
+public:
+    /**
+     * @brief Starts the encoder threads.
+     *
+     * @param thread_count Number of encoder threads (at least one is started).
+     * @param queue_capacity Maximum number of images waiting to be encoded (at least one).
+     * @param on_written Optional callback run on the encoder thread after each successful write,
+     *        with the pixel bytes the write had to copy (see pixel_copy_scope).
+     * @param scheduler Scheduler deflating the bands of each PNG, joined by the encoder thread;
+     *        it must outlive the pool. Without one, every PNG is deflated on its encoder
+     *        thread alone, so the pool never starts threads of its own beyond thread_count.
+     */
+    explicit encoder_pool(std::size_t thread_count = 1, std::size_t queue_capacity = 4,
+                          std::function<void(std::size_t tag, unsigned long long copied_bytes)> on_written = nullptr,
+                          task_scheduler* scheduler = nullptr);
+
+    /**
+     * @brief Writes everything still queued and joins the encoder threads.
+     */
+    ~encoder_pool();
+
+    encoder_pool(const encoder_pool&) = delete;
+    encoder_pool& operator=(const encoder_pool&) = delete;
+
+    /**
+     * @brief Queues an image to be saved, blocking while the queue is full.
+     *
+     * @param image The image to save; it is moved into the queue.
+     * @param path The output file; its format follows the extension and missing parent directories are created.
+     * @param tag Caller-defined identifier reported back on success or failure.
+     * @param png Settings used when the output is a PNG, which is written by the parallel PNG writer.
+     * @param memory Budget held for the image, released once it is written or has failed.
+     */
+    void submit(cimg_library::CImg<unsigned char>&& image, std::string path, std::size_t tag = 0, const png_options& png = png_options(),
+                memory_reservation memory = memory_reservation());
+
+    /**
+     * @brief Queues an image held in a pooled buffer; the buffer goes back to its pool once written.
+     *
+     * @param image The image to save; it is moved into the queue.
+     * @param path The output file, as for the overload above.
+     * @param tag Caller-defined identifier reported back on success or failure.
+     * @param png Settings used when the output is a PNG.
+     * @param memory Budget held for the image, as for the overload above.
+     */
+    void submit(pooled_image&& image, std::string path, std::size_t tag = 0, const png_options& png = png_options(),
+                memory_reservation memory = memory_reservation());
+
+    /**
+     * @brief Waits until every submitted image has been written.
+     *
+     * @return std::vector<encode_failure> The writes that failed since the previous flush.
+     */
+    std::vector<encode_failure> flush();
+
+    /**
+     * @brief Returns the number of encoder threads.
+     */
+    std::size_t size() const { return workers.size(); }
+
+    /**
+     * @brief Returns the number of images taken off the queue so far, written or failed.
+     */
+    std::size_t encoded() const { return items_done.load(); }
+
+    /**
+     * @brief Returns the time the encoder threads spent encoding and writing, summed over threads.
+     */
+    double busy_seconds() const { return busy_nanoseconds.load() / 1e9; }
+
+private:
+    // Move-only, like everything holding pixels between stages
+    struct encode_item {
+        cimg_library::CImg<unsigned char> image;
+        std::string path;
+        std::size_t tag;
+        png_options png;
+        pooled_image pooled;
+        memory_reservation memory;
+        allocation_observer* allocations = nullptr;
+
+        encode_item() = default;
+        encode_item(cimg_library::CImg<unsigned char>&& image, std::string path, std::size_t tag, const png_options& png,
+                    pooled_image&& pooled, memory_reservation&& memory, allocation_observer* allocations)
+            : image(std::move(image)), path(std::move(path)), tag(tag), png(png), pooled(std::move(pooled)), memory(std::move(memory)),
+              allocations(allocations) {}
+        encode_item(encode_item&&) = default;
+        encode_item& operator=(encode_item&&) = default;
+        encode_item(const encode_item&) = delete;
+        encode_item& operator=(const encode_item&) = delete;
+    };
+
+    void worker_loop();
+
+    bounded_queue<encode_item> queue;
+    std::vector<std::thread> workers;
+    std::size_t in_flight = 0;
+    std::vector<encode_failure> failures;
+    std::function<void(std::size_t tag, unsigned long long copied_bytes)> on_written;
+    task_scheduler* scheduler;
+    std::atomic<std::size_t> items_done{0};
+    std::atomic<unsigned long long> busy_nanoseconds{0};
+    std::mutex mutex;
+    std::condition_variable drained;
+};
+
+#endif // ENCODER_POOL_H
@@ -0,0 +1,122 @@
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Where huge_page_resource places allocations at or above its threshold.
+ */
+enum class huge_page_mode {
+    off,          ///< Everything comes from the upstream resource.
+    transparent,  ///< 2 MiB-aligned anonymous mappings with madvise(MADV_HUGEPAGE).
+    hugetlb       ///< The preallocated hugetlbfs pool (MAP_HUGETLB), falling back to transparent.
+};
+
+/**
+ * @brief Parses "off", "thp" or "hugetlb".
+ *
+ * @throws std::invalid_argument For any other name.
+ */
+huge_page_mode parse_huge_page_mode(const std::string& name);
+
+/**
+ * @brief Counters of the large allocations of a huge_page_resource.
+ */
+struct huge_page_stats {
+    std::size_t allocations = 0;    ///< Allocations mapped on huge-page boundaries.
+    unsigned long long bytes = 0;   ///< Bytes mapped for them, rounded up to whole huge pages.
+    std::size_t hugetlb = 0;        ///< Of those, served from the hugetlbfs pool.
+    std::size_t fallbacks = 0;      ///< hugetlb requests the pool could not serve, mapped transparently instead.
+};
+
+/**
+ * @brief Memory resource backing large buffers with 2 MiB pages.
+ *
+ * A 100 MP intermediate spans tens of thousands of 4 KiB pages, more than the TLB holds, so
+ * passes that walk it column-wise or across channel planes miss the TLB on nearly every
+ * row. Requests at or above the threshold are mapped on 2 MiB boundaries and marked with
+ * madvise(MADV_HUGEPAGE), which lets the kernel back them with transparent huge pages even
+ * when THP is in "madvise" mode; in hugetlb mode they come from the pool reserved through
+ * /proc/sys/vm/nr_hugepages first. Smaller requests, where rounding to 2 MiB would waste
+ * memory, go to the upstream resource. Thread-safe.
+ *
+ * The shared resource also backs the global operator new (see allocation_tracking.cpp)
+ * through map() and unmap(), so CImg's own buffers, e.g. decoded sources and resize()
+ * outputs, get huge pages too.
+ */
+class huge_page_resource : public std::pmr::memory_resource {
+public:
+    static constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+    /**
+     * @brief Creates a resource.
+     *
+     * @param mode Where large allocations go.
+     * @param threshold Smallest request that is mapped on huge pages.
+     * @param upstream Serves the smaller requests, and every request when mode is off.
+     */
+    explicit huge_page_resource(huge_page_mode mode = huge_page_mode::transparent, std::size_t threshold = std::size_t(4) << 20,
+                                std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+    /**
+     * @brief Unmaps whatever large allocations are still live.
+     */
+    ~huge_page_resource() override;
+
+    huge_page_resource(const huge_page_resource&) = delete;
+    huge_page_resource& operator=(const huge_page_resource&) = delete;
+
+    /**
+     * @brief Returns the process-wide resource used for image buffers (buffer_pool,
+     * aligned_image, arena blocks, and large operator new requests). It is never destroyed,
+     * so buffers freed during static destruction still find their mappings.
+     */
+    static huge_page_resource& shared();
+
+    /**
+     * @brief Maps a block on huge pages if the request reaches the threshold.
+     *
+     * Never calls the upstream resource, so operator new can use it.
+     *
+     * @return void* The block, or nullptr if the request is to be served elsewhere.
+     */
+    void* map(std::size_t bytes, std::size_t alignment);
+
+    /**
+     * @brief Unmaps a block returned by map() or allocate().
+     *
+     * @return bool false if pointer is not one of this resource's mappings.
+     */
+    bool unmap(void* pointer);
+
+    /**
+     * @brief Changes the mode and threshold; only later allocations are affected.
+     */
+    void configure(huge_page_mode mode, std::size_t threshold);
+
+    /**
+     * @brief Returns the counters accumulated since construction.
+     */
+    huge_page_stats stats() const;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    huge_page_mode mode;
+    std::size_t threshold;
+    std::pmr::memory_resource* upstream;
+    // Threshold, or SIZE_MAX when mode is off, for a lock-free early exit in map()
+    std::atomic<std::size_t> smallest_mapped;
+    std::map<void*, std::size_t> mappings;
+    huge_page_stats counters;
+    mutable std::mutex mutex;
+};
+
+#endif // HUGE_PAGES_H
@@ -0,0 +1,28 @@
+#ifndef IMAGE_HEADER_H
+#define IMAGE_HEADER_H
+
+#include <string>
+
+/**
+ * @brief Size of an image file as CImg will decode it.
+ */
+struct image_header {
+    int width = 0;
+    int height = 0;
+    int channels = 0;  ///< Channels of the decoded CImg, e.g. 3 for a palette PNG without transparency.
+};
+
+/**
+ * @brief Reads the dimensions of an image file without decoding its pixels.
+ *
+ * Recognises PNG, JPEG, BMP and binary PNM by their signatures, whatever the extension.
+ * Channel counts follow the decoders: palettes are expanded (with alpha when a PNG has a
+ * transparency chunk, assumed possible here), BMPs always decode to three channels.
+ *
+ * @param path The image file.
+ * @param header Receives the dimensions.
+ * @return bool False if the file cannot be read or its format is not recognised.
+ */
+bool read_image_header(const std::string& path, image_header& header);
+
+#endif // IMAGE_HEADER_H
@@ -0,0 +1,63 @@
+#ifndef IMAGE_TASKS_H
+#define IMAGE_TASKS_H
+
+#include "CImg.h"
+#include "png_writer.h"
+#include "resize_image_base.h"
+#include "task.h"
+#include "task_scheduler.h"
+#include <string>
+
+/**
+ * @brief Coroutine versions of the load, resize and save steps, for composing pipelines as
+ *
+ *     task<void> handle(std::string in, std::string out, const resize_image_base& resizer) {
+ *         auto image = co_await load_task(in);
+ *         auto resized = co_await resize_task(resizer, std::move(image), 800, 600);
+ *         co_await save_task(std::move(resized), out);
+ *     }
+ *
+ * Every step hops onto the given scheduler (the shared one by default), the same workers that
+ * run the resize bands, so decoding, resizing and encoding share one set of threads instead of
+ * competing pools. No thread waits between steps: a coroutine is suspended until its step is
+ * done and then continues on whichever worker finished it. References passed to a task must
+ * stay valid until it completes.
+ */
+
+/**
+ * @brief Decodes an image file on a scheduler worker.
+ *
+ * @param path The image file.
+ * @param scheduler The scheduler to decode on.
+ * @return task<cimg_library::CImg<unsigned char>> The decoded image; CImg's exception if loading fails.
+ */
+task<cimg_library::CImg<unsigned char>> load_task(std::string path, task_scheduler& scheduler = task_scheduler::shared());
+
+/**
+ * @brief Resizes an image with resize_image_base::resize_async, its bands spread over the scheduler.
+ *
+ * @param resizer The resizing method.
+ * @param source The original image; move it in to avoid a copy.
+ * @param new_width The desired width.
+ * @param new_height The desired height.
+ * @param scheduler The scheduler running the resize.
+ * @param cancel Stops the resize between row bands; awaiting then throws operation_cancelled.
+ * @return task<cimg_library::CImg<unsigned char>> The resized image.
+ */
+task<cimg_library::CImg<unsigned char>> resize_task(const resize_image_base& resizer, cimg_library::CImg<unsigned char> source,
+                                                    int new_width, int new_height, task_scheduler& scheduler = task_scheduler::shared(),
+                                                    cancellation_token cancel = cancellation_token());
+
+/**
+ * @brief Encodes and writes an image with write_image on a scheduler worker.
+ *
+ * @param image The image to save, moved in; it is released once written.
+ * @param path The output file; its format follows the extension.
+ * @param png Settings used when the output is a PNG.
+ * @param scheduler The scheduler to encode on.
+ * @return task<void> Completes once the file is written.
+ */
+task<void> save_task(cimg_library::CImg<unsigned char> image, std::string path, png_options png = png_options(),
+                     task_scheduler& scheduler = task_scheduler::shared());
+
+#endif // IMAGE_TASKS_H
@@ -0,0 +1,203 @@
+#ifndef IMAGE_VIEW_H
+#define IMAGE_VIEW_H
+
+#include "CImg.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief Alignment in bytes of the rows of aligned image storage: one cache line, and a
+ * multiple of every SIMD register width.
+ */
+constexpr std::size_t image_row_alignment = 64;
+
+/**
+ * @brief Returns width rounded up to a whole number of aligned rows.
+ */
+constexpr std::ptrdiff_t aligned_row_stride(int width) {
+    return (static_cast<std::ptrdiff_t>(width) + image_row_alignment - 1) / image_row_alignment * image_row_alignment;
+}
+
+/**
+ * @brief Axis-aligned rectangle in pixel coordinates.
+ */
+struct image_rect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+/**
+ * @brief How the samples of one pixel are arranged in memory.
+ */
+enum class pixel_layout {
+    planar,      ///< Each channel is a separate plane; neighbouring samples of a row are adjacent (CImg).
+    interleaved  ///< The channels of a pixel are adjacent, e.g. RGBRGB... (decoders, numpy, shared memory).
+};
+
+/**
+ * @brief Non-owning view of 8-bit pixels with arbitrary row and channel strides.
+ *
+ * Sample (x, y, c) lives at data()[y * row_stride() + x * pixel_stride() + c * channel_stride()],
+ * so sub-rectangles, padded rows and interleaved buffers from foreign code can be resized in
+ * place instead of being copied into a CImg first. A view is a few words and is passed by
+ * value or const reference; the memory it points to must outlive it. Every CImg converts
+ * implicitly to a view of its first slice.
+ *
+ * @tparam T unsigned char for a writable view, const unsigned char for a read-only one.
+ */
+template <typename T>
+class basic_image_view {
+public:
+    /**
+     * @brief Creates an empty view.
+     */
+    basic_image_view() = default;
+
+    /**
+     * @brief Views an external buffer.
+     *
+     * @param data The first sample of pixel (0, 0), channel 0.
+     * @param width Pixels per row.
+     * @param height Number of rows.
+     * @param channels Samples per pixel.
+     * @param layout Planar: neighbouring pixels are one sample apart. Interleaved: they are
+     *        channels * channel_stride samples apart.
+     * @param row_stride Samples from one row to the next, padding included.
+     * @param channel_stride Samples from one channel of a pixel to the next.
+     */
+    basic_image_view(T* data, int width, int height, int channels, pixel_layout layout, std::ptrdiff_t row_stride,
+                     std::ptrdiff_t channel_stride)
+        : pixels(data), view_width(width), view_height(height), view_channels(channels), view_layout(layout),
+          rows(row_stride), planes(channel_stride), step(layout == pixel_layout::planar ? 1 : channels * channel_stride) {}
+
+    /**
+     * @brief Views a CImg; implicit so every kernel taking a view also takes a CImg.
+     */
+    basic_image_view(cimg_library::CImg<unsigned char>& image)
+        : basic_image_view(image.data(), image.width(), image.height(), image.spectrum(), pixel_layout::planar, image.width(),
+                           static_cast<std::ptrdiff_t>(image.width()) * image.height() * image.depth()) {}
+
+    /**
+     * @brief Views a const CImg; only read-only views can be made from one.
+     */
+    template <typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+    basic_image_view(const cimg_library::CImg<unsigned char>& image)
+        : basic_image_view(image.data(), image.width(), image.height(), image.spectrum(), pixel_layout::planar, image.width(),
+                           static_cast<std::ptrdiff_t>(image.width()) * image.height() * image.depth()) {}
+
+    /**
+     * @brief Converts a writable view to a read-only one.
+     */
+    template <typename U, typename = std::enable_if_t<std::is_const_v<T> && std::is_same_v<const U, T>>>
+    basic_image_view(const basic_image_view<U>& other)
+        : basic_image_view(other.data(), other.width(), other.height(), other.channels(), other.layout(), other.row_stride(),
+                           other.channel_stride()) {
+        padded_tail = other.aligned_rows();
+    }
+
+    /**
+     * @brief Views a planar buffer, e.g. CImg-style pixels owned by someone else.
+     *
+     * @param row_stride Samples per row; defaults to width.
+     * @param channel_stride Samples per plane; defaults to row_stride * height.
+     */
+    static basic_image_view planar(T* data, int width, int height, int channels, std::ptrdiff_t row_stride = 0,
+                                   std::ptrdiff_t channel_stride = 0) {
+        row_stride = row_stride > 0 ? row_stride : width;
+        channel_stride = channel_stride > 0 ? channel_stride : row_stride * height;
+        return basic_image_view(data, width, height, channels, pixel_layout::planar, row_stride, channel_stride);
+    }
+
+    /**
+     * @brief Views planar storage whose rows are aligned and padded, e.g. an aligned_image.
+     *
+     * @param data Storage aligned to image_row_alignment.
+     * @param row_stride Samples per row; a multiple of image_row_alignment, at least
+     *        aligned_row_stride(width). The padding belongs to the view and may be overwritten.
+     */
+    static basic_image_view aligned(T* data, int width, int height, int channels, std::ptrdiff_t row_stride) {
+        basic_image_view view(data, width, height, channels, pixel_layout::planar, row_stride, row_stride * height);
+        view.padded_tail = true;
+        return view;
+    }
+
+    /**
+     * @brief Views an interleaved buffer such as decoder output or a numpy HxWxC array.
+     *
+     * @param row_stride Samples per row, padding included; defaults to width * channels.
+     */
+    static basic_image_view interleaved(T* data, int width, int height, int channels, std::ptrdiff_t row_stride = 0) {
+        row_stride = row_stride > 0 ? row_stride : static_cast<std::ptrdiff_t>(width) * channels;
+        return basic_image_view(data, width, height, channels, pixel_layout::interleaved, row_stride, 1);
+    }
+
+    T* data() const { return pixels; }
+    int width() const { return view_width; }
+    int height() const { return view_height; }
+    int channels() const { return view_channels; }
+    pixel_layout layout() const { return view_layout; }
+    std::ptrdiff_t row_stride() const { return rows; }
+    std::ptrdiff_t channel_stride() const { return planes; }
+
+    /**
+     * @brief Returns the distance in samples between horizontally neighbouring pixels.
+     */
+    std::ptrdiff_t pixel_stride() const { return step; }
+
+    /**
+     * @brief Returns whether the view has no pixels.
+     */
+    bool empty() const { return !pixels || view_width <= 0 || view_height <= 0 || view_channels <= 0; }
+
+    /**
+     * @brief Returns whether every row starts on an image_row_alignment boundary and is padded
+     * to aligned_row_stride(width()) samples.
+     *
+     * Kernels may then use aligned full-vector loads and stores for a whole padded row,
+     * tail included, without a scalar remainder loop; the padding samples hold no pixels.
+     * Only views made by aligned() (or converted from one) qualify: a crop's padding would be
+     * its neighbours' pixels.
+     */
+    bool aligned_rows() const {
+        return padded_tail && reinterpret_cast<std::uintptr_t>(pixels) % image_row_alignment == 0 &&
+               rows % image_row_alignment == 0 && planes % image_row_alignment == 0 && rows >= aligned_row_stride(view_width);
+    }
+
+    /**
+     * @brief Returns sample (x, y, c); no bounds checking.
+     */
+    T& operator()(int x, int y, int c) const { return pixels[y * rows + x * step + c * planes]; }
+
+    /**
+     * @brief Returns the first sample of one channel of a row; later pixels are pixel_stride() apart.
+     */
+    T* row(int y, int c) const { return pixels + y * rows + c * planes; }
+
+    /**
+     * @brief Returns a view of a rectangle of this view, sharing its pixels.
+     *
+     * @param rect A rectangle inside the view.
+     */
+    basic_image_view crop(const image_rect& rect) const {
+        return basic_image_view(pixels + rect.y * rows + rect.x * step, rect.width, rect.height, view_channels, view_layout, rows, planes);
+    }
+
+private:
+    T* pixels = nullptr;
+    int view_width = 0;
+    int view_height = 0;
+    int view_channels = 0;
+    pixel_layout view_layout = pixel_layout::planar;
+    std::ptrdiff_t rows = 0;
+    std::ptrdiff_t planes = 0;
+    std::ptrdiff_t step = 1;
+    bool padded_tail = false;
+};
+
+using image_view = basic_image_view<const unsigned char>;
+using mutable_image_view = basic_image_view<unsigned char>;
+
+#endif // IMAGE_VIEW_H
@@ -0,0 +1,115 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include "cancellation_token.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+/**
+ * @brief Usage counters of a memory_budget.
+ */
+struct memory_budget_stats {
+    std::size_t limit_bytes = 0;          ///< The budget; zero means unlimited.
+    std::size_t reserved_bytes = 0;       ///< Bytes currently reserved.
+    std::size_t peak_reserved_bytes = 0;  ///< Highest reserved_bytes so far.
+    std::size_t admitted = 0;             ///< Reservations granted.
+    std::size_t waited = 0;               ///< Reservations that had to wait for room.
+    std::size_t oversized = 0;            ///< Reservations larger than the budget, admitted alone.
+    double wait_seconds = 0.0;            ///< Time spent waiting, summed over reservations.
+};
+
+class memory_budget;
+
+/**
+ * @brief Move-only share of a memory_budget; gives its bytes back when destroyed.
+ */
+class memory_reservation {
+public:
+    /**
+     * @brief Creates an empty reservation holding no bytes.
+     */
+    memory_reservation() = default;
+
+    memory_reservation(memory_reservation&& other) noexcept;
+    memory_reservation& operator=(memory_reservation&& other) noexcept;
+    memory_reservation(const memory_reservation&) = delete;
+    memory_reservation& operator=(const memory_reservation&) = delete;
+
+    ~memory_reservation() { release(); }
+
+    /**
+     * @brief Returns the bytes held.
+     */
+    std::size_t bytes() const { return held; }
+
+    /**
+     * @brief Moves part of the reservation into a new one, e.g. for an output that outlives its job.
+     *
+     * @param bytes Bytes to move, clamped to bytes().
+     * @return memory_reservation The split-off part, released independently.
+     */
+    memory_reservation split(std::size_t bytes);
+
+    /**
+     * @brief Gives the bytes back to the budget now and wakes waiting reservations.
+     */
+    void release();
+
+private:
+    friend class memory_budget;
+
+    memory_reservation(memory_budget* budget, std::size_t bytes) : owner(budget), held(bytes) {}
+
+    memory_budget* owner = nullptr;
+    std::size_t held = 0;
+};
+
+/**
+ * @brief Admission control that keeps the estimated memory of running jobs under a limit.
+ *
+ * A job reserves its estimated peak footprint before it starts and holds the reservation
+ * until its memory is freed; reserve() blocks while the reservation would push the total
+ * over the limit, so under a burst of large inputs jobs queue up instead of all decoding at
+ * once. A job larger than the whole budget is admitted once nothing else is reserved, so it
+ * runs alone rather than never. The budget only counts what jobs reserve: buffers retained
+ * by a buffer_pool for reuse are capped separately. Thread-safe.
+ */
+class memory_budget {
+public:
+    /**
+     * @brief Creates a budget.
+     *
+     * @param limit_bytes The most bytes reserved at once; zero admits everything immediately.
+     */
+    explicit memory_budget(std::size_t limit_bytes = 0);
+
+    memory_budget(const memory_budget&) = delete;
+    memory_budget& operator=(const memory_budget&) = delete;
+
+    /**
+     * @brief Reserves bytes, waiting until they fit.
+     *
+     * @param bytes The estimated peak footprint of the job.
+     * @param cancel Stops the wait when cancelled or past its deadline.
+     * @return memory_reservation The reservation; it must not outlive the budget.
+     * @throws operation_cancelled If the token was cancelled while waiting.
+     */
+    memory_reservation reserve(std::size_t bytes, const cancellation_token& cancel = cancellation_token());
+
+    /**
+     * @brief Returns the counters accumulated since construction.
+     */
+    memory_budget_stats stats() const;
+
+private:
+    friend class memory_reservation;
+
+    void release(std::size_t bytes);
+
+    mutable std::mutex mutex;
+    std::condition_variable room;
+    memory_budget_stats counters;
+};
+
+#endif // MEMORY_BUDGET_H
@@ -0,0 +1,55 @@
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The NUMA nodes of the machine and the CPUs that belong to each.
+ *
+ * Read once from /sys/devices/system/node. Machines without that directory (or with a
+ * single node) are described as one node holding every online CPU. Memory placement
+ * follows Linux's default first-touch policy: a page lives on the node of the CPU that
+ * first writes it, so a buffer allocated and filled by a thread pinned with
+ * pin_current_thread() is local to that thread's node.
+ */
+class numa_topology {
+public:
+    /**
+     * @brief Returns the topology of this machine.
+     */
+    static const numa_topology& system();
+
+    /**
+     * @brief Returns the number of nodes that have CPUs (at least one).
+     */
+    std::size_t node_count() const { return node_cpus.size(); }
+
+    /**
+     * @brief Returns the CPUs of a node.
+     *
+     * @param node A node index below node_count().
+     */
+    const std::vector<int>& cpus(std::size_t node) const { return node_cpus[node]; }
+
+    /**
+     * @brief Restricts the calling thread to the CPUs of a node.
+     *
+     * @param node A node index below node_count().
+     * @return bool False if the affinity could not be set; the thread then runs anywhere.
+     */
+    bool pin_current_thread(std::size_t node) const;
+
+    /**
+     * @brief Returns the node of the CPU the calling thread is running on.
+     */
+    std::size_t current_node() const;
+
+private:
+    numa_topology();
+
+    std::vector<std::vector<int>> node_cpus;
+    std::vector<std::size_t> cpu_node;
+};
+
+#endif // NUMA_TOPOLOGY_H
@@ -0,0 +1,42 @@
+#ifndef OUTPUT_POISON_H
+#define OUTPUT_POISON_H
+
+#include "CImg.h"
+#include "image_view.h"
+
+/**
+ * @brief Byte written into fresh output storage while poisoning is on.
+ */
+constexpr unsigned char output_poison_byte = 0xA5;
+
+/**
+ * @brief Turns output poisoning on or off for the whole process.
+ *
+ * Resize outputs are allocated without zero-filling because every kernel writes each pixel
+ * of its output, and a memset would be a full extra write pass. A kernel that misses pixels
+ * would then leave stale memory, or a recycled buffer's previous image, that can look right.
+ * With poisoning on, every uninitialized output is first filled with output_poison_byte, so
+ * coverage bugs show up as a fixed pattern in the files written. It costs the write pass
+ * that skipping the fill saves, and first-touch NUMA placement, so it is a debug mode.
+ * Defaults to on when RESIZE_POISON_OUTPUTS=1 is set in the environment.
+ */
+void set_output_poisoning(bool enabled);
+
+/**
+ * @brief Returns whether output poisoning is on.
+ */
+bool output_poisoning();
+
+/**
+ * @brief Fills an output with output_poison_byte if poisoning is on, otherwise does nothing.
+ */
+void poison_output(const mutable_image_view& output);
+
+/**
+ * @brief Allocates an output image without initializing it (poisoned in debug mode).
+ *
+ * Only for outputs a kernel is about to cover completely.
+ */
+cimg_library::CImg<unsigned char> uninitialized_output(int width, int height, int channels);
+
+#endif // OUTPUT_POISON_H
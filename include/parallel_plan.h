@@ -0,0 +1,43 @@
+#ifndef PARALLEL_PLAN_H
+#define PARALLEL_PLAN_H
+
+#include <cstddef>
+#include <string>
+
+class task_scheduler;
+
+/**
+ * @brief How a row-parallel operation is split over the scheduler.
+ */
+struct parallel_plan {
+    std::size_t threads = 1;          ///< Workers the rows are spread over; one means serial.
+    std::size_t bands = 1;            ///< Number of tasks.
+    std::size_t band_rows = 0;        ///< Rows per task (the last band may be shorter).
+    std::size_t taps = 0;             ///< Source samples read per output sample.
+    double work_seconds = 0.0;        ///< Estimated serial time of the whole operation.
+    double overhead_seconds = 0.0;    ///< Measured cost of scheduling one task.
+
+    /**
+     * @brief Returns a one-line description such as "4 threads, 16 bands of 32 rows, ...".
+     */
+    std::string describe() const;
+};
+
+/**
+ * @brief Chooses the thread count and band size of a row-parallel operation.
+ *
+ * Each band has to be worth at least ten task overheads, so small images stay on the
+ * calling thread while large ones use every worker with four bands each for balance. Bands
+ * are also kept under about a millisecond, since cancellation and interactive work only
+ * get in between bands.
+ *
+ * @param rows Number of rows to split.
+ * @param taps_per_row Source samples read per row, over all channels.
+ * @param taps Source samples read per output sample, recorded in the plan.
+ * @param tap_seconds Measured cost of one tap.
+ * @param scheduler The scheduler that will run the bands.
+ * @return parallel_plan The chosen split.
+ */
+parallel_plan plan_parallel(std::size_t rows, double taps_per_row, std::size_t taps, double tap_seconds, const task_scheduler& scheduler);
+
+#endif // PARALLEL_PLAN_H
@@ -0,0 +1,58 @@
+#ifndef PIPE_SERVER_H
+#define PIPE_SERVER_H
+
+#include "png_writer.h"
+#include <cstddef>
+#include <cstdio>
+#include <iosfwd>
+
+/**
+ * @brief Largest payload a pipe_server request may declare: 1 GiB.
+ */
+constexpr std::size_t pipe_max_payload_bytes = std::size_t(1) << 30;
+
+/**
+ * @brief Serves resize requests framed on a byte stream, typically stdin/stdout.
+ *
+ * Each request is one ASCII header line followed by a binary payload:
+ *
+ *     <format> <bytes> <size> <method> [option=value...]\n<payload>
+ *
+ * where format is "png" (an encoded PNG) or "raw" (interleaved 8-bit samples, which needs
+ * a "dims=WxHxC" option), size is a size_spec and method a resizer name. Other options are
+ * "out=png|raw" (defaults to the input format) and the per-job PNG settings accepted in
+ * manifests. Every request is answered, in order, by one frame:
+ *
+ *     <format> <bytes> <width>x<height>x<channels>\n<payload>
+ *     error <bytes>\n<message>
+ *
+ * A request that fails after its payload was read gets an error frame and the stream
+ * continues; a malformed header ends the session because the stream cannot be resynchronised.
+ * A <bytes> field that is not a decimal count, exceeds pipe_max_payload_bytes or cannot be
+ * allocated counts as a malformed header.
+ */
+class pipe_server {
+public:
+    /**
+     * @brief Creates a server.
+     *
+     * @param png_defaults PNG settings for requests that do not override them.
+     * @param log Stream receiving one line per request, or nullptr for silence. Must not be the output stream.
+     */
+    explicit pipe_server(const png_options& png_defaults = png_options(), std::ostream* log = nullptr);
+
+    /**
+     * @brief Answers requests until the input reaches end of file.
+     *
+     * @param in The request stream.
+     * @param out The response stream; it is flushed after every frame.
+     * @return int Zero if every request succeeded, one if some failed, two if the session ended on a malformed header.
+     */
+    int serve(std::FILE* in, std::FILE* out);
+
+private:
+    png_options png_defaults;
+    std::ostream* log;
+};
+
+#endif // PIPE_SERVER_H
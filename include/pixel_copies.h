@@ -0,0 +1,49 @@
+#ifndef PIXEL_COPIES_H
+#define PIXEL_COPIES_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Counts the pixel bytes explicitly copied on the current thread while it is alive.
+ *
+ * Stages hand images on by move, so pixels should only be copied where a format or an API
+ * forces it (e.g. CImg's savers need dense rows). Every such place reports its bytes with
+ * count_pixel_copy(); a stage opens a scope around the work it does for one job, so the
+ * counter shows how many bytes that job copied. Copies CImg makes on its own (e.g. a copy
+ * constructor) do not pass the hook and are not counted.
+ *
+ * Work handed to other threads keeps its counter: task_scheduler tasks run under the
+ * counter current when they were submitted, so the row bands of a job count into the job.
+ * Scopes nest, the innermost one counts, and a null counter or no scope stops counting.
+ */
+class pixel_copy_scope {
+public:
+    /**
+     * @brief Starts counting into counter, which must outlive the scope and the tasks submitted in it.
+     */
+    explicit pixel_copy_scope(std::atomic<unsigned long long>* counter);
+
+    /**
+     * @brief Stops counting and reopens the enclosing scope, if any.
+     */
+    ~pixel_copy_scope();
+
+    pixel_copy_scope(const pixel_copy_scope&) = delete;
+    pixel_copy_scope& operator=(const pixel_copy_scope&) = delete;
+
+    /**
+     * @brief Returns the calling thread's current counter, or nullptr.
+     */
+    static std::atomic<unsigned long long>* current();
+
+private:
+    std::atomic<unsigned long long>* previous;
+};
+
+/**
+ * @brief Adds bytes to the innermost pixel_copy_scope of the current thread.
+ */
+void count_pixel_copy(std::size_t bytes);
+
+#endif // PIXEL_COPIES_H
@@ -0,0 +1,85 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include "image_view.h"
+#include "task_scheduler.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief PNG row filter selection.
+ *
+ * adaptive picks, per row, the filter with the smallest sum of absolute filtered bytes.
+ */
+enum class png_filter { none, sub, up, average, paeth, adaptive };
+
+/**
+ * @brief Settings of the parallel PNG writer.
+ */
+struct png_options {
+    int level = 6;
+    png_filter filter = png_filter::adaptive;
+    unsigned threads = 0;
+    unsigned band_rows = 0;
+};
+
+/**
+ * @brief Parses a filter name ("none", "sub", "up", "average", "paeth" or "adaptive").
+ *
+ * @throws std::invalid_argument If the name is unknown.
+ */
+png_filter parse_png_filter(const std::string& name);
+
+/**
+ * @brief Encodes an 8-bit image as PNG, deflating row bands in parallel on a scheduler.
+ *
+ * The image is split into bands of rows that are filtered and deflated independently, each
+ * with a fresh dictionary. Every band but the last ends on a sync flush, so the raw deflate
+ * streams concatenate into one valid zlib stream whose Adler-32 is combined from the band
+ * checksums, as pigz does. Images with 1 to 4 channels are written as gray, gray+alpha,
+ * RGB or RGBA. The bands run through scheduler.parallel_for(), the calling thread included.
+ *
+ * @param image The image to encode.
+ * @param options Compression level (0-9), filter, how many threads may deflate at once (0
+ *                for every worker, 1 to stay on the calling thread) and rows per band (0
+ *                picks bands of about 256 KiB).
+ * @param scheduler The scheduler running the bands.
+ * @param out Receives the encoded file.
+ * @throws std::invalid_argument If the image has no pixels or more than four channels.
+ * @throws std::runtime_error If zlib reports an error.
+ */
+void encode_png(const image_view& image, const png_options& options, task_scheduler& scheduler, std::vector<unsigned char>& out);
+
+/**
+ * @brief Encodes on the shared scheduler, or on the calling thread alone if options.threads is 1.
+ */
+void encode_png(const image_view& image, const png_options& options, std::vector<unsigned char>& out);
+
+/**
+ * @brief Encodes an image with encode_png and writes it to a file.
+ *
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void write_png(const image_view& image, const std::string& path, const png_options& options, task_scheduler& scheduler);
+
+/**
+ * @brief Writes a PNG encoded as by the encode_png overload without a scheduler.
+ */
+void write_png(const image_view& image, const std::string& path, const png_options& options);
+
+/**
+ * @brief Writes an image in the format of the path's extension, creating missing parent directories.
+ *
+ * PNGs go through write_png; other formats are saved by CImg, from a copy when the view is
+ * not laid out like a CImg.
+ *
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void write_image(const image_view& image, const std::string& path, const png_options& options, task_scheduler& scheduler);
+
+/**
+ * @brief Writes an image as above, encoding PNGs as by the encode_png overload without a scheduler.
+ */
+void write_image(const image_view& image, const std::string& path, const png_options& options);
+
+#endif // PNG_WRITER_H
@@ -20,7 +20,7 @@ public:
      * @param new_height The desired height of the resized image.
      * @return cimg_library::CImg<unsigned char> The resized image.
      */
-    cimg_library::CImg<unsigned char> resize(const cimg_library::CImg<unsigned char>& source, int new_width, int new_height) const override;
+    cimg_library::CImg<unsigned char> resize(const image_view& source, int new_width, int new_height) const override;
 
 protected:
     /**
@@ -32,7 +32,12 @@ protected:
      * @param channel The color channel to estimate.
      * @return unsigned char The estimated color value.
      */
-    unsigned char estimate_color(const cimg_library::CImg<unsigned char>& source, float x, float y, int channel) const override;
+    unsigned char estimate_color(const image_view& source, float x, float y, int channel) const override;
+
+    /**
+     * @brief Gives the source span read along one axis, including the second interpolation neighbour.
+     */
+    void sample_span(int first, int last, int source_size, int new_size, int& begin, int& end) const override;
 
 private:
     float interpolate(float start, float end, float factor) const;
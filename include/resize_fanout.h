@@ -0,0 +1,82 @@
+#ifndef RESIZE_FANOUT_H
+#define RESIZE_FANOUT_H
+
+#include "CImg.h"
+#include "cancellation_token.h"
+#include "image_view.h"
+#include "parallel_plan.h"
+#include "task_scheduler.h"
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One output of a fan-out resize.
+ */
+struct resize_target {
+    int width;
+    int height;
+    std::string method;
+};
+
+/**
+ * @brief Resizes one source image to several targets in a single sweep over its rows.
+ *
+ * Coordinate tables are computed once per distinct (method, width) and per target height.
+ * Targets that share a method and width also share the horizontal pass: each source row is
+ * resampled horizontally once per group and then reused by every target of the group.
+ * Source rows no target needs are skipped. The sweep is split into bands of source rows
+ * that run as scheduler tasks, as chosen by plan_fanout(), so a large source spreads over
+ * every worker while a small one is swept on the calling thread. The results
+ * are identical to calling the corresponding resize_image_base::resize for every target.
+ *
+ * @param source The original image, any layout.
+ * @param targets The requested outputs; methods are "nearest" or "bilinear".
+ * @param scheduler The scheduler running the bands.
+ * @param cancel Checked every few source rows of each band; the partial outputs
+ *        are freed before operation_cancelled propagates.
+ * @param scratch Memory for the coordinate tables and row caches, e.g. an arena reset after
+ *        each image; the outputs are always heap-allocated since they outlive the call.
+ * @return std::vector<cimg_library::CImg<unsigned char>> One image per target, in target order.
+ * @throws std::invalid_argument If a target has an unknown method or a non-positive size.
+ * @throws operation_cancelled If the token was cancelled before the sweep finished.
+ */
+std::vector<cimg_library::CImg<unsigned char>> resize_fanout(const image_view& source, const std::vector<resize_target>& targets,
+                                                            task_scheduler& scheduler = task_scheduler::shared(),
+                                                            const cancellation_token& cancel = cancellation_token(),
+                                                            std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+/**
+ * @brief Runs resize_fanout() into caller-provided pixels, e.g. buffers from a buffer_pool.
+ *
+ * @param source The original image, any layout.
+ * @param targets The requested outputs.
+ * @param outputs One view per target, sized to it with the source's channel count; the
+ *        layout need not match the source's, e.g. a CImg source can fill an interleaved buffer.
+ * @param scheduler The scheduler running the bands.
+ * @param cancel As for resize_fanout().
+ * @param scratch As for resize_fanout().
+ * @throws std::invalid_argument If a target is invalid or an output does not match its target.
+ * @throws operation_cancelled If the token was cancelled before the sweep finished.
+ */
+void resize_fanout_into(const image_view& source, const std::vector<resize_target>& targets,
+                        const std::vector<mutable_image_view>& outputs, task_scheduler& scheduler = task_scheduler::shared(),
+                        const cancellation_token& cancel = cancellation_token(),
+                        std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+/**
+ * @brief Chooses how resize_fanout() splits the sweep over a scheduler.
+ *
+ * The cost is the taps of all targets (one per sample for nearest, four for bilinear) times
+ * the sweep's cost per tap, measured once per process.
+ *
+ * @param source The original image.
+ * @param targets The requested outputs.
+ * @param scheduler The scheduler that would run the bands.
+ * @return parallel_plan The thread count and bands of source rows.
+ * @throws std::invalid_argument If a target has an unknown method.
+ */
+parallel_plan plan_fanout(const image_view& source, const std::vector<resize_target>& targets,
+                          const task_scheduler& scheduler);
+
+#endif // RESIZE_FANOUT_H
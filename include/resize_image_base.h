@@ -2,12 +2,37 @@
 #define RESIZE_IMAGE_BASE_H
 
 #include "CImg.h"
+#include "async_result.h"
+#include "cancellation_token.h"
+#include "image_view.h"
+#include "parallel_plan.h"
+
+class task_scheduler;
+
+/**
+ * @brief Full-image sizes of a resize; together they fix the sampling ratios.
+ */
+struct resize_geometry {
+    int source_width;
+    int source_height;
+    int new_width;
+    int new_height;
+};
+
+/**
+ * @brief How resize_parallel() splits the output into tasks.
+ */
+enum class parallel_mode {
+    row_bands,  ///< Full-width bands of output rows.
+    tiles       ///< 2D output tiles sized so a tile and its source footprint fit in L2.
+};
 
 /**
  * @brief Abstract base class for image resizing.
  * 
  * This class provides an interface for resizing images. Derived classes must implement
- * the resize method to provide specific resizing algorithms.
+ * the resize method to provide specific resizing algorithms. Kernels read and write through
+ * image_view, so a CImg, a sub-rectangle or a foreign strided buffer is resized without a copy.
  */
 class resize_image_base {
 public:
@@ -22,12 +47,135 @@ public:
      * Derived classes must implement this method to resize the given source image
      * to the specified new dimensions.
      * 
-     * @param source The original image to be resized.
+     * @param source The original image to be resized, any layout.
      * @param new_width The desired width of the resized image.
      * @param new_height The desired height of the resized image.
      * @return cimg_library::CImg<unsigned char> The resized image.
      */
-    virtual cimg_library::CImg<unsigned char> resize(const cimg_library::CImg<unsigned char>& source, int new_width, int new_height) const = 0;
+    virtual cimg_library::CImg<unsigned char> resize(const image_view& source, int new_width, int new_height) const = 0;
+
+    /**
+     * @brief Computes one rectangle of a resize from a window of the source.
+     *
+     * Output pixels are sampled exactly as resize() would sample them for the full geometry,
+     * so stitching the rectangles of a partition gives the same image as a single resize().
+     * The window only has to cover source_footprint() of the rectangle.
+     *
+     * @param window Source pixels; window pixel (0, 0) is source pixel (window_x, window_y).
+     * @param window_x The source column of the window's first column.
+     * @param window_y The source row of the window's first row.
+     * @param result Destination; result pixel (0, 0) is output pixel (result_x, result_y).
+     * @param result_x The output column of the destination's first column.
+     * @param result_y The output row of the destination's first row.
+     * @param geometry Full source and output sizes.
+     * @param output The rectangle of the output to compute, in output coordinates.
+     */
+    void resize_region(const image_view& window, int window_x, int window_y,
+                       const mutable_image_view& result, int result_x, int result_y,
+                       const resize_geometry& geometry, const image_rect& output) const;
+
+    /**
+     * @brief Chooses how resize_parallel() splits an output over a scheduler.
+     *
+     * The serial cost is estimated from the output samples, the filter taps per sample and
+     * the kernel's cost per tap, measured once per resizer class; plan_parallel() then weighs it
+     * against the scheduler's measured task overhead.
+     *
+     * @param geometry Full source and output sizes.
+     * @param channels Number of channels.
+     * @param scheduler The scheduler that would run the bands.
+     * @return parallel_plan The thread count and row bands, for resize_parallel() and debug output.
+     */
+    parallel_plan plan(const resize_geometry& geometry, int channels, const task_scheduler& scheduler) const;
+
+    /**
+     * @brief Fills a whole output image, splitting it into tasks run on a scheduler.
+     *
+     * Row bands follow plan(), so an icon is resized on the calling thread and a large
+     * output spreads over every worker. On very wide images every band streams
+     * whole source rows through the cache; tiles instead cover a 2D block of the output
+     * sized so the block and its source footprint (filter margin included) fit in half of
+     * L2. Row bands are the default: prefetching favours their long sequential streams unless
+     * many threads compete for memory bandwidth (see bench/resize_modes.cpp).
+     *
+     * @param source The original image.
+     * @param result The output pixels, already sized to the target dimensions.
+     * Every band or tile checks the token before it starts; once it is cancelled the remaining
+     * ones are skipped and operation_cancelled is thrown, leaving the result partly written.
+     *
+     * @param scheduler The scheduler running the tasks.
+     * @param mode The partitioning; both modes produce identical output.
+     * @param cancel Stops the resize early when cancelled or past its deadline.
+     * @throws operation_cancelled If the token was cancelled before the last band started.
+     */
+    void resize_parallel(const image_view& source, const mutable_image_view& result,
+                         task_scheduler& scheduler, parallel_mode mode = parallel_mode::row_bands,
+                         const cancellation_token& cancel = cancellation_token()) const;
+
+    /**
+     * @brief Starts a resize on a scheduler and returns without waiting for it.
+     *
+     * Continuations chain further stages on executors of the caller's choice, e.g.
+     * resize_async(std::move(image), w, h).then(io_pool, [](CImg<unsigned char> out) { ... }).
+     * The resizer must outlive the operation.
+     *
+     * @param source The original image, moved in; it is released as soon as the resize is done.
+     *        Pass an explicit copy to keep using it.
+     * @param new_width The desired width of the resized image.
+     * @param new_height The desired height of the resized image.
+     * @param scheduler The scheduler running the resize and its row bands.
+     * @param cancel Stops the resize between row bands; the source and the partial output
+     *        are released as soon as it stops.
+     * @return async_result<cimg_library::CImg<unsigned char>> The resized image,
+     *         std::invalid_argument if a size is not positive, or operation_cancelled.
+     */
+    async_result<cimg_library::CImg<unsigned char>> resize_async(cimg_library::CImg<unsigned char>&& source, int new_width, int new_height,
+                                                                 task_scheduler& scheduler,
+                                                                 const cancellation_token& cancel = cancellation_token()) const;
+
+    /**
+     * @brief Starts a resize on the shared scheduler; see the overload above.
+     */
+    async_result<cimg_library::CImg<unsigned char>> resize_async(cimg_library::CImg<unsigned char>&& source, int new_width, int new_height) const;
+
+    /**
+     * @brief Downscales an image inside its own buffer, for callers that no longer need the source.
+     *
+     * Output rows are computed a band at a time, channel by channel, and written over the
+     * start of the source buffer as soon as no remaining band reads the bytes underneath, so
+     * peak memory is the source plus about one band instead of source and output. The
+     * returned image reuses the source allocation (its logical size is shrunk, its capacity
+     * is not) and equals resize() pixel for pixel. Band rows run in parallel on the
+     * scheduler, but through estimate_color() rather than the fanout's table-driven rows, so
+     * this trades speed for memory.
+     *
+     * @param image The image to resize; it is consumed, and on an exception it is partly overwritten.
+     * @param new_width The desired width, at most the source width.
+     * @param new_height The desired height, at most the source height.
+     * @param scheduler The scheduler running the rows of each band.
+     * @param cancel Checked before every band.
+     * @return cimg_library::CImg<unsigned char> The resized image, in the source's buffer.
+     * @throws std::invalid_argument If a size is not positive, the target is larger than the
+     *         source along either axis, or the image has more than one slice.
+     * @throws operation_cancelled If the token was cancelled before the last band started.
+     */
+    cimg_library::CImg<unsigned char> resize_inplace(cimg_library::CImg<unsigned char>&& image, int new_width, int new_height,
+                                                     task_scheduler& scheduler,
+                                                     const cancellation_token& cancel = cancellation_token()) const;
+
+    /**
+     * @brief Downscales an image inside its own buffer on the shared scheduler; see the overload above.
+     */
+    cimg_library::CImg<unsigned char> resize_inplace(cimg_library::CImg<unsigned char>&& image, int new_width, int new_height) const;
+
+    /**
+     * @brief Returns the source rectangle read when computing an output rectangle.
+     *
+     * @param geometry Full source and output sizes.
+     * @param output The rectangle of the output, in output coordinates.
+     * @return image_rect The source pixels the rectangle depends on, filter margin included.
+     */
+    image_rect source_footprint(const resize_geometry& geometry, const image_rect& output) const;
 
 protected:
     /**
@@ -41,7 +189,30 @@ protected:
      * @param channel The color channel to estimate.
      * @return unsigned char The estimated color value.
      */
-    virtual unsigned char estimate_color(const cimg_library::CImg<unsigned char>& source, float x, float y, int channel) const = 0;
+    virtual unsigned char estimate_color(const image_view& source, float x, float y, int channel) const = 0;
+
+    /**
+     * @brief Pure virtual method giving the source pixels estimate_color reads along one axis.
+     *
+     * @param first The first output coordinate of the span.
+     * @param last The last output coordinate of the span (inclusive).
+     * @param source_size The source size along the axis.
+     * @param new_size The output size along the axis.
+     * @param begin Receives the first source coordinate read.
+     * @param end Receives one past the last source coordinate read.
+     */
+    virtual void sample_span(int first, int last, int source_size, int new_size, int& begin, int& end) const = 0;
+
+private:
+    /**
+     * @brief Returns the source samples estimate_color() reads per output sample.
+     */
+    std::size_t taps_per_sample(const resize_geometry& geometry) const;
+
+    /**
+     * @brief Returns the time of one tap of estimate_color(), measured once per resizer class.
+     */
+    double tap_seconds() const;
 };
 
 #endif // RESIZE_IMAGE_BASE_H
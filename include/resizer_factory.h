@@ -0,0 +1,22 @@
+#ifndef RESIZER_FACTORY_H
+#define RESIZER_FACTORY_H
+
+#include "resize_image_base.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Creates the resizer registered under the given method name.
+ *
+ * @param method The method name, "nearest" or "bilinear".
+ * @return std::unique_ptr<resize_image_base> The resizer, or nullptr if the name is unknown.
+ */
+std::unique_ptr<resize_image_base> create_resizer(const std::string& method);
+
+/**
+ * @brief Returns the names of all methods accepted by create_resizer.
+ */
+const std::vector<std::string>& resizer_methods();
+
+#endif // RESIZER_FACTORY_H
@@ -0,0 +1,246 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include "async_result.h"
+#include "task_scheduler.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+class task;
+
+namespace task_detail {
+
+/**
+ * @brief Promise state common to every task: the awaiting coroutine and a pending exception.
+ */
+struct promise_base {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    /**
+     * @brief Hands control back to the awaiting coroutine when the task finishes.
+     */
+    struct final_awaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {
+            return finished.promise().continuation;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    final_awaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct promise : promise_base {
+    std::optional<T> value;
+
+    task<T> get_return_object();
+    void return_value(T result) { value.emplace(std::move(result)); }
+
+    T take() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct promise<void> : promise_base {
+    task<void> get_return_object();
+    void return_void() const noexcept {}
+
+    void take() const {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+/**
+ * @brief Coroutine that starts immediately and frees itself when done; used to launch tasks.
+ */
+struct detached {
+    struct promise_type {
+        detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+} // namespace task_detail
+
+/**
+ * @brief Lazily started coroutine producing a T, awaited with co_await.
+ *
+ * A task does nothing until it is awaited; finishing resumes the awaiting coroutine directly
+ * (symmetric transfer), so a chain like co_await load(); co_await resize(); co_await save();
+ * costs no thread switches of its own. Where a stage runs is decided inside it, by awaiting
+ * schedule_on() or an async_result, so every stage can share the task_scheduler that runs
+ * the resize bands. Exceptions propagate to the awaiter. Tasks are move-only and awaited once.
+ *
+ * @tparam T The result type, or void.
+ */
+template <typename T>
+class task {
+public:
+    using promise_type = task_detail::promise<T>;
+
+    task(task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    /**
+     * @brief Starts the task and suspends the awaiting coroutine until it finishes.
+     */
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().take(); }
+        };
+        return awaiter{handle};
+    }
+
+private:
+    friend struct task_detail::promise<T>;
+
+    explicit task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+task<T> task_detail::promise<T>::get_return_object() {
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_detail::promise<void>::get_return_object() {
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+/**
+ * @brief Awaitable that resumes the awaiting coroutine on a worker of a scheduler.
+ */
+struct schedule_awaiter {
+    task_scheduler& scheduler;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> awaiting) const { scheduler.submit([awaiting] { awaiting.resume(); }); }
+    void await_resume() const noexcept {}
+};
+
+/**
+ * @brief Moves the awaiting coroutine onto a scheduler: co_await schedule_on(scheduler);
+ */
+inline schedule_awaiter schedule_on(task_scheduler& scheduler) {
+    return schedule_awaiter{scheduler};
+}
+
+/**
+ * @brief Lets a coroutine await an async_result, resuming on the thread that completes it.
+ */
+template <typename T>
+auto operator co_await(async_result<T>&& result) {
+    struct awaiter {
+        async_result<T> pending;
+        async_result<T> finished;
+
+        bool await_ready() const { return pending.ready(); }
+
+        void await_suspend(std::coroutine_handle<> awaiting) {
+            static inline_executor resume_inline;
+            // The callback may run right here if the result completed meanwhile; nothing
+            // touches the awaiter after resume() since the coroutine may have destroyed it
+            pending.on_complete(resume_inline, [this, awaiting](async_result<T> done) {
+                finished = std::move(done);
+                awaiting.resume();
+            });
+        }
+
+        T await_resume() { return finished.valid() ? finished.get() : pending.get(); }
+    };
+    return awaiter{std::move(result), async_result<T>()};
+}
+
+namespace task_detail {
+
+template <typename T>
+detached run_detached(task<T> work, async_promise<T> promise) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(work);
+            promise.set_value();
+        } else {
+            promise.set_value(co_await std::move(work));
+        }
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+} // namespace task_detail
+
+/**
+ * @brief Starts a task from ordinary code and returns its eventual result.
+ *
+ * The task runs on the calling thread until its first suspension.
+ *
+ * @param work The task to run.
+ * @return async_result<T> The task's value or exception.
+ */
+template <typename T>
+async_result<T> start(task<T> work) {
+    async_promise<T> promise;
+    async_result<T> result = promise.result();
+    task_detail::run_detached(std::move(work), promise);
+    return result;
+}
+
+/**
+ * @brief Runs a task to completion, blocking the calling thread; for main() and tests.
+ *
+ * Must not be called from a worker of a scheduler the task runs on.
+ */
+template <typename T>
+T sync_wait(task<T> work) {
+    return start(std::move(work)).get();
+}
+
+#endif // TASK_H
@@ -0,0 +1,235 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class allocation_observer;
+
+/**
+ * @brief Scheduling class of a task.
+ */
+enum class task_priority {
+    interactive,  ///< Latency-sensitive work such as thumbnails for a waiting client.
+    bulk          ///< Throughput work such as batch re-encodes; runs when no interactive task is queued.
+};
+
+/**
+ * @brief Work-stealing scheduler shared by batch jobs and the row bands inside each resize.
+ *
+ * Every worker owns a deque. Tasks submitted from a worker go to the back of its own deque
+ * and are popped LIFO, which keeps a resize's bands on the core that decoded its source;
+ * idle workers steal FIFO from the front of other deques, so the bands of one large image
+ * spread over all cores while small images stay whole. Tasks must not throw; use
+ * parallel_for() when failures have to reach the caller.
+ *
+ * With NUMA pinning, workers are split into contiguous blocks, one per node, and each is
+ * pinned to the CPUs of its node. Thieves then look at the deques of their own node before
+ * crossing to another one, and submit(task, node) places a task on a given node, so a job
+ * whose buffers were first touched on a node is processed there. Such a task stays on its
+ * node: thieves from other nodes pass over it, and it waits for one of the node's workers.
+ *
+ * Tasks are interactive or bulk. A task submitted without a class inherits the class of the
+ * task that submits it (interactive from outside the workers), so the row bands of a bulk
+ * resize are bulk too. Whenever a worker picks its next task it takes queued interactive
+ * work first, anywhere in the pool, so an interactive request waits at most for the row
+ * bands already running, not for a whole bulk job. The bulk share reserves a fraction of
+ * the workers for bulk tasks even while interactive work is queued, so a steady stream of
+ * interactive requests cannot starve a batch.
+ */
+class task_scheduler {
+public:
+    /**
+     * @brief Starts the workers.
+     *
+     * @param thread_count Number of workers. Zero selects std::thread::hardware_concurrency().
+     * @param pin_to_nodes Whether to spread the workers over the NUMA nodes and pin them there.
+     */
+    explicit task_scheduler(std::size_t thread_count = 0, bool pin_to_nodes = false);
+
+    /**
+     * @brief Waits for all queued tasks to finish and joins the workers.
+     */
+    ~task_scheduler();
+
+    task_scheduler(const task_scheduler&) = delete;
+    task_scheduler& operator=(const task_scheduler&) = delete;
+
+    /**
+     * @brief Returns the process-wide scheduler, created on first use with one worker per core.
+     */
+    static task_scheduler& shared();
+
+    /**
+     * @brief Queues a task, on the calling worker's deque when called from a worker.
+     *
+     * @param task The callable to run.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Queues a task of a given class, on the calling worker's deque when called from a worker.
+     *
+     * @param task The callable to run.
+     * @param priority The class of the task and of the tasks it submits.
+     */
+    void submit(std::function<void()> task, task_priority priority);
+
+    /**
+     * @brief Queues a task on a worker of a NUMA node, the caller's own deque if it is one.
+     *
+     * Only the node's workers run it; it is never stolen across nodes.
+     *
+     * @param task The callable to run.
+     * @param node A node index below node_count().
+     */
+    void submit(std::function<void()> task, std::size_t node);
+
+    /**
+     * @brief Queues a task of a given class on a worker of a NUMA node.
+     *
+     * @param task The callable to run.
+     * @param node A node index below node_count().
+     * @param priority The class of the task and of the tasks it submits.
+     */
+    void submit(std::function<void()> task, std::size_t node, task_priority priority);
+
+    /**
+     * @brief Runs body over [0, count) in chunks of grain items and waits for all of them.
+     *
+     * Chunks go to whichever thread claims them first, the caller included, and the caller
+     * keeps claiming until none is left, so nested calls from inside a task cannot deadlock.
+     * It runs no other task while it waits, except that a bulk caller still takes queued
+     * interactive tasks between chunks. The first exception thrown by body is rethrown
+     * once every chunk has finished.
+     *
+     * @param count Number of items.
+     * @param grain Items per chunk (at least one).
+     * @param body Called as body(begin, end) for each chunk.
+     */
+    void parallel_for(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body);
+
+    /**
+     * @brief Blocks until no task is queued or running. Must not be called from a worker.
+     */
+    void wait_idle();
+
+    /**
+     * @brief Returns the number of worker threads.
+     */
+    std::size_t size() const { return workers.size(); }
+
+    /**
+     * @brief Returns the number of NUMA nodes the workers are spread over (one without pinning).
+     */
+    std::size_t node_count() const { return node_workers.size(); }
+
+    /**
+     * @brief Returns the node of the calling worker, or of the calling thread's CPU otherwise.
+     */
+    std::size_t current_node() const;
+
+    /**
+     * @brief Returns the cost of handing one task to the workers, measured at construction.
+     *
+     * Timed as the median round trip of an empty task through an idle worker, which covers
+     * queueing and waking; used to decide whether splitting work pays.
+     */
+    double task_overhead_seconds() const { return overhead_seconds; }
+
+    /**
+     * @brief Returns the class inherited by tasks submitted from the calling thread.
+     */
+    static task_priority current_priority();
+
+    /**
+     * @brief Sets the fraction of workers that keep running bulk tasks while interactive
+     *        tasks are queued.
+     *
+     * The share is rounded down to whole workers, so the default of zero (and any share on
+     * a single worker) gives interactive tasks strict precedence at every band boundary.
+     *
+     * @param share A fraction from 0 to 1.
+     */
+    void set_bulk_share(double share);
+
+    /**
+     * @brief Returns the time the workers spent running tasks, summed over workers.
+     *
+     * Chunks a parallel_for() caller runs on its own thread are not included.
+     */
+    double busy_seconds() const { return busy_nanoseconds.load() / 1e9; }
+
+    /**
+     * @brief Records time a worker spent inside a task on another stage's behalf, e.g.
+     *        deflating PNG bands for an encoder thread that already counts that time as its own.
+     *
+     * Ignored when not called from one of this scheduler's workers, since busy_seconds()
+     * only covers worker time.
+     *
+     * @param time The time spent.
+     */
+    void note_lent(std::chrono::nanoseconds time);
+
+    /**
+     * @brief Returns the part of busy_seconds() recorded with note_lent().
+     */
+    double lent_seconds() const { return lent_nanoseconds.load() / 1e9; }
+
+private:
+    static const std::size_t priority_count = 2;
+
+    // A task runs under the allocation observer and pixel copy counter that were current
+    // when it was submitted
+    struct queued_task {
+        std::function<void()> run;
+        allocation_observer* allocations = nullptr;
+        std::atomic<unsigned long long>* copies = nullptr;
+        bool node_bound = false;  // Submitted for a node; only that node's workers take it
+    };
+
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<queued_task> tasks[priority_count];
+    };
+
+    void worker_loop(std::size_t index);
+    void measure_overhead();
+    bool run_one(std::size_t home, bool interactive_only = false);
+    bool take(std::size_t home, task_priority priority, queued_task& task);
+    void push(std::size_t home, std::function<void()> task, task_priority priority, bool node_bound = false);
+    bool has_work_for(std::size_t worker) const;
+    std::size_t current_worker() const;
+
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<std::thread> workers;
+    std::vector<std::size_t> worker_node;
+    std::vector<std::vector<std::size_t>> node_workers;
+    bool pinned;
+    std::atomic<std::size_t> queued{0};
+    // Queued node-bound tasks per node and in total, so a worker only wakes for work it may take
+    std::vector<std::atomic<std::size_t>> bound_queued;
+    std::atomic<std::size_t> bound_total{0};
+    std::atomic<std::size_t> queued_by_priority[priority_count] = {};
+    std::atomic<std::size_t> bulk_running{0};
+    std::atomic<std::size_t> bulk_reserved{0};
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> next_queue{0};
+    std::atomic<unsigned long long> busy_nanoseconds{0};
+    std::atomic<unsigned long long> lent_nanoseconds{0};
+    double overhead_seconds = 0.0;
+    std::mutex sleep_mutex;
+    std::condition_variable work_available;
+    std::condition_variable idle;
+    bool stopping = false;
+};
+
+#endif // TASK_SCHEDULER_H
@@ -0,0 +1,193 @@
+#ifndef TILED_TIFF_H
+#define TILED_TIFF_H
+
+#include "CImg.h"
+#include "resize_image_base.h"
+#include "task_scheduler.h"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Random-access reader for the tiles of an 8-bit TIFF.
+ *
+ * Handles classic and BigTIFF files in either byte order, tiled or stripped layout (a strip
+ * is read as a full-width tile), chunky samples, and no, Deflate or Adobe Deflate compression
+ * with optional horizontal predictor. Only the first image directory is used. Tiles are read
+ * with pread(), so read_tile() and read_region() may be called from several threads.
+ */
+class tiff_reader {
+public:
+    /**
+     * @brief Opens a file and parses its first image directory.
+     *
+     * @param path The TIFF file.
+     * @throws std::runtime_error If the file cannot be read or uses an unsupported layout.
+     */
+    explicit tiff_reader(const std::string& path);
+    ~tiff_reader();
+
+    tiff_reader(const tiff_reader&) = delete;
+    tiff_reader& operator=(const tiff_reader&) = delete;
+
+    int width() const { return image_width; }
+    int height() const { return image_height; }
+    int channels() const { return samples; }
+    int tile_width() const { return tile_w; }
+    int tile_height() const { return tile_h; }
+
+    /**
+     * @brief Decodes one tile into interleaved samples of tile_width() x tile_height() pixels.
+     *
+     * @param tile_x The tile column.
+     * @param tile_y The tile row.
+     * @param pixels Receives the samples; pixels outside the image are unspecified.
+     * @throws std::runtime_error If the tile cannot be read or decoded.
+     */
+    void read_tile(int tile_x, int tile_y, std::vector<unsigned char>& pixels) const;
+
+    /**
+     * @brief Decodes a source rectangle into a planar image, reading only the tiles it touches.
+     *
+     * @param rect The rectangle, which must lie inside the image.
+     * @param out Receives a rect.width x rect.height image with channels() channels.
+     */
+    void read_region(const image_rect& rect, cimg_library::CImg<unsigned char>& out) const;
+
+private:
+    int fd = -1;
+    bool big_endian = false;
+    int image_width = 0;
+    int image_height = 0;
+    int samples = 0;
+    int tile_w = 0;
+    int tile_h = 0;
+    int tiles_across = 0;
+    int compression = 1;
+    int predictor = 1;
+    std::vector<std::uint64_t> offsets;
+    std::vector<std::uint64_t> byte_counts;
+};
+
+/**
+ * @brief TIFF compression written by tiff_writer.
+ */
+enum class tiff_compression { none = 1, deflate = 8 };
+
+/**
+ * @brief Writer for 8-bit chunky tiled TIFFs whose tiles may arrive in any order.
+ *
+ * Tiles are appended to the file as they are written, so only one tile per caller is held
+ * in memory; the directory with the tile offsets is written by finish(). BigTIFF is used when
+ * the uncompressed image would not fit the 4 GiB addressing of classic TIFF. write_tile() is
+ * thread-safe.
+ */
+class tiff_writer {
+public:
+    /**
+     * @brief Creates the file.
+     *
+     * @param path The output file.
+     * @param width The image width.
+     * @param height The image height.
+     * @param channels Samples per pixel, 1 to 4 (gray, gray+alpha, RGB, RGBA).
+     * @param tile_width The tile width, a multiple of 16.
+     * @param tile_height The tile height, a multiple of 16.
+     * @param compression The compression of every tile.
+     * @throws std::runtime_error If the file cannot be created.
+     * @throws std::invalid_argument If the layout is not valid TIFF.
+     */
+    tiff_writer(const std::string& path, int width, int height, int channels, int tile_width, int tile_height,
+                tiff_compression compression = tiff_compression::deflate);
+    ~tiff_writer();
+
+    tiff_writer(const tiff_writer&) = delete;
+    tiff_writer& operator=(const tiff_writer&) = delete;
+
+    /**
+     * @brief Encodes and appends one tile.
+     *
+     * @param tile_x The tile column.
+     * @param tile_y The tile row.
+     * @param tile Planar pixels of the tile; it may be smaller than the tile size at the right and bottom edges.
+     * @throws std::runtime_error If the write fails.
+     */
+    void write_tile(int tile_x, int tile_y, const cimg_library::CImg<unsigned char>& tile);
+
+    /**
+     * @brief Writes the image directory and closes the file.
+     *
+     * @throws std::runtime_error If a tile is missing or the write fails.
+     */
+    void finish();
+
+private:
+    int fd = -1;
+    bool big_tiff = false;
+    int image_width;
+    int image_height;
+    int samples;
+    int tile_w;
+    int tile_h;
+    int tiles_across;
+    tiff_compression compression;
+    std::uint64_t file_end;
+    std::vector<std::uint64_t> offsets;
+    std::vector<std::uint64_t> byte_counts;
+    std::mutex mutex;
+};
+
+/**
+ * @brief Settings of a tile-by-tile resize.
+ */
+struct tiled_resize_options {
+    int tile_width = 256;
+    int tile_height = 256;
+    std::size_t window_budget = 64u << 20;
+};
+
+/**
+ * @brief Resizes a TIFF tile by tile without holding the whole source or output in memory.
+ *
+ * The output is cut into tiles, one scheduler task each; each task maps its tile to the source footprint it needs
+ * (filter margin included), decodes only the source tiles overlapping that footprint and
+ * resizes into the tile. When a footprint exceeds window_budget bytes the output tile is
+ * processed in smaller row bands, so peak memory stays around
+ * workers x (window_budget + one source tile + one output tile).
+ *
+ * @param reader The source.
+ * @param resizer The resizing method.
+ * @param new_width The output width.
+ * @param new_height The output height.
+ * @param options Tile size and window budget.
+ * @param scheduler The scheduler running the tiles.
+ * @param sink Receives each finished output tile with its rectangle; called concurrently.
+ * @param cancel Checked before every source window is read; once cancelled no further tiles
+ *        reach the sink and operation_cancelled is thrown.
+ */
+void resize_tiled(const tiff_reader& reader, const resize_image_base& resizer, int new_width, int new_height,
+                  const tiled_resize_options& options, task_scheduler& scheduler,
+                  const std::function<void(const image_rect&, const cimg_library::CImg<unsigned char>&)>& sink,
+                  const cancellation_token& cancel = cancellation_token());
+
+/**
+ * @brief Resizes a TIFF tile by tile straight into a whole output, with no per-tile copy.
+ *
+ * Works like the overload above, but every task resizes into its rectangle of output, so
+ * a non-TIFF output is assembled without copying the tiles into it.
+ *
+ * @param reader The source.
+ * @param resizer The resizing method.
+ * @param options Tile size and window budget.
+ * @param scheduler The scheduler running the tiles.
+ * @param output The whole output, with reader.channels() channels; its size is the target size.
+ * @param cancel As for the overload above; the output is then partly written.
+ * @throws std::invalid_argument If the output's channel count differs from the source's.
+ */
+void resize_tiled(const tiff_reader& reader, const resize_image_base& resizer, const tiled_resize_options& options,
+                  task_scheduler& scheduler, const mutable_image_view& output,
+                  const cancellation_token& cancel = cancellation_token());
+
+#endif // TILED_TIFF_H
@@ -0,0 +1,65 @@
+#include "aligned_image.h"
+#include "huge_pages.h"
+#include "output_poison.h"
+#include "pixel_copies.h"
+#include <algorithm>
+#include <utility>
+
+using namespace cimg_library;
+
+aligned_image::aligned_image(int width, int height, int channels)
+    : image_width(width), image_height(height), image_channels(channels), stride(aligned_row_stride(width)) {
+    pixels = static_cast<unsigned char*>(huge_page_resource::shared().allocate(std::max<std::size_t>(bytes(), 1), image_row_alignment));
+    poison_output(view());
+}
+
+aligned_image::aligned_image(const image_view& source) : aligned_image(source.width(), source.height(), source.channels()) {
+    count_pixel_copy(static_cast<std::size_t>(image_width) * image_height * image_channels);
+    for (int c = 0; c < image_channels; ++c) {
+        for (int y = 0; y < image_height; ++y) {
+            const unsigned char* in = source.row(y, c);
+            unsigned char* out = pixels + (static_cast<std::size_t>(c) * image_height + y) * stride;
+            if (source.pixel_stride() == 1) {
+                std::copy(in, in + image_width, out);
+            } else {
+                for (int x = 0; x < image_width; ++x) {
+                    out[x] = in[x * source.pixel_stride()];
+                }
+            }
+        }
+    }
+}
+
+aligned_image::aligned_image(aligned_image&& other) noexcept
+    : pixels(std::exchange(other.pixels, nullptr)), image_width(std::exchange(other.image_width, 0)),
+      image_height(std::exchange(other.image_height, 0)), image_channels(std::exchange(other.image_channels, 0)),
+      stride(std::exchange(other.stride, 0)) {}
+
+aligned_image& aligned_image::operator=(aligned_image&& other) noexcept {
+    if (this != &other) {
+        std::swap(pixels, other.pixels);
+        std::swap(image_width, other.image_width);
+        std::swap(image_height, other.image_height);
+        std::swap(image_channels, other.image_channels);
+        std::swap(stride, other.stride);
+    }
+    return *this;
+}
+
+aligned_image::~aligned_image() {
+    if (pixels) {
+        huge_page_resource::shared().deallocate(pixels, std::max<std::size_t>(bytes(), 1), image_row_alignment);
+    }
+}
+
+CImg<unsigned char> aligned_image::to_cimg() const {
+    CImg<unsigned char> image(image_width, image_height, 1, image_channels);
+    count_pixel_copy(image.size());
+    for (int c = 0; c < image_channels; ++c) {
+        for (int y = 0; y < image_height; ++y) {
+            const unsigned char* in = pixels + (static_cast<std::size_t>(c) * image_height + y) * stride;
+            std::copy(in, in + image_width, image.data(0, y, 0, c));
+        }
+    }
+    return image;
+}
@@ -0,0 +1,135 @@
+#include "allocation_tracking.h"
+#include "huge_pages.h"
+#include <cstdint>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+namespace {
+
+thread_local allocation_observer* current_observer = nullptr;
+
+void raise_peak(std::atomic<std::size_t>& peak, std::size_t value) {
+    std::size_t seen = peak.load(std::memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+void* tracked_allocate(std::size_t size, std::size_t alignment) {
+    // Large blocks (CImg's image buffers) go on huge pages like the pooled ones; the
+    // resource reports them to the observer itself
+    if (void* mapped = huge_page_resource::shared().map(size, alignment)) {
+        return mapped;
+    }
+    void* block = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        block = std::malloc(size ? size : 1);
+    } else {
+        block = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    if (current_observer) {
+        current_observer->allocated(malloc_usable_size(block));
+    }
+    return block;
+}
+
+void tracked_free(void* block) noexcept {
+    // Mappings start on a huge page; a malloc block almost never does, so most frees skip the lookup
+    const std::uintptr_t huge_page_mask = huge_page_resource::huge_page_size - 1;
+    if ((reinterpret_cast<std::uintptr_t>(block) & huge_page_mask) == 0 && block && huge_page_resource::shared().unmap(block)) {
+        return;
+    }
+    if (block && current_observer) {
+        current_observer->deallocated(malloc_usable_size(block));
+    }
+    std::free(block);
+}
+
+} // namespace
+
+// The global allocation functions are replaced so that every heap allocation, CImg's
+// included, passes the hook; the array and nothrow forms forward to these
+void* operator new(std::size_t size) {
+    return tracked_allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return tracked_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* block) noexcept {
+    tracked_free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    tracked_free(block);
+}
+
+void operator delete(void* block, std::align_val_t) noexcept {
+    tracked_free(block);
+}
+
+void operator delete(void* block, std::size_t, std::align_val_t) noexcept {
+    tracked_free(block);
+}
+
+allocation_scope::allocation_scope(allocation_observer* observer) : previous(current_observer) {
+    current_observer = observer;
+}
+
+allocation_scope::~allocation_scope() {
+    current_observer = previous;
+}
+
+allocation_observer* allocation_scope::current() {
+    return current_observer;
+}
+
+void note_allocation(std::size_t bytes) {
+    if (current_observer) {
+        current_observer->allocated(bytes);
+    }
+}
+
+void note_deallocation(std::size_t bytes) {
+    if (current_observer) {
+        current_observer->deallocated(bytes);
+    }
+}
+
+job_allocations::job_allocations() {
+    for (phase_observer& observer : phases) {
+        observer.job = this;
+    }
+}
+
+void job_allocations::phase_observer::allocated(std::size_t size) {
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    long long now = job->live.fetch_add(static_cast<long long>(size), std::memory_order_relaxed) + static_cast<long long>(size);
+    if (now > 0) {
+        raise_peak(peak, static_cast<std::size_t>(now));
+        raise_peak(job->peak, static_cast<std::size_t>(now));
+    }
+}
+
+void job_allocations::phase_observer::deallocated(std::size_t size) {
+    job->live.fetch_sub(static_cast<long long>(size), std::memory_order_relaxed);
+}
+
+job_allocation_stats job_allocations::stats() const {
+    job_allocation_stats result;
+    allocation_counters* counters[] = {&result.decode, &result.resize, &result.encode};
+    for (int i = 0; i < 3; ++i) {
+        counters[i]->bytes = phases[i].bytes.load();
+        counters[i]->count = phases[i].count.load();
+        counters[i]->peak_bytes = phases[i].peak.load();
+        result.total.bytes += counters[i]->bytes;
+        result.total.count += counters[i]->count;
+    }
+    result.total.peak_bytes = peak.load();
+    return result;
+}
@@ -0,0 +1,85 @@
+#include "arena.h"
+#include "allocation_tracking.h"
+#include "huge_pages.h"
+#include "output_poison.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+using namespace cimg_library;
+
+arena_stats& arena_stats::operator+=(const arena_stats& other) {
+    allocations += other.allocations;
+    bytes += other.bytes;
+    blocks += other.blocks;
+    block_bytes += other.block_bytes;
+    resets += other.resets;
+    return *this;
+}
+
+arena::arena(std::size_t block_size)
+    : block_size(std::max<std::size_t>(block_size, 4096)) {}
+
+arena::~arena() {
+    allocation_scope untracked(nullptr);
+    for (const block& entry : blocks) {
+        huge_page_resource::shared().deallocate(entry.data, entry.size, alignof(std::max_align_t));
+    }
+}
+
+void arena::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = 0;
+    offset = 0;
+    ++counters.resets;
+    note_deallocation(handed_out);
+    handed_out = 0;
+}
+
+arena_stats arena::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+CImg<unsigned char> arena::image(int width, int height, int channels) {
+    std::size_t size = static_cast<std::size_t>(width) * height * channels;
+    auto* pixels = static_cast<unsigned char*>(allocate(std::max<std::size_t>(size, 1), alignof(std::max_align_t)));
+    CImg<unsigned char> image(pixels, width, height, 1, channels, true);
+    poison_output(image);
+    return image;
+}
+
+void* arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.allocations;
+    counters.bytes += bytes;
+    // Allocation tracking sees what the arena hands out, freed at reset(); its blocks are
+    // kept across resets and are not charged to anyone
+    note_allocation(bytes);
+    handed_out += bytes;
+
+    // Try the current block, then the blocks kept from before the last reset
+    for (; current < blocks.size(); ++current, offset = 0) {
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(blocks[current].data);
+        std::size_t start = ((base + offset + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1)) - base;
+        if (start + bytes <= blocks[current].size) {
+            offset = start + bytes;
+            return blocks[current].data + start;
+        }
+    }
+
+    // Blocks are aligned to max_align_t; larger alignments get slack in the block. Blocks
+    // for large images come from huge pages.
+    std::size_t size = std::max(block_size, bytes + (alignment > alignof(std::max_align_t) ? alignment : 0));
+    allocation_scope untracked(nullptr);
+    block fresh{static_cast<unsigned char*>(huge_page_resource::shared().allocate(size, alignof(std::max_align_t))), size};
+    blocks.push_back(fresh);
+    ++counters.blocks;
+    counters.block_bytes += size;
+
+    current = blocks.size() - 1;
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(fresh.data);
+    std::size_t start = ((base + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1)) - base;
+    offset = start + bytes;
+    return fresh.data + start;
+}
@@ -0,0 +1,197 @@
+#include "batch_job.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <glob.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool parse_positive_int(const std::string& text, int& value) {
+    if (text.empty() || !std::all_of(text.begin(), text.end(), [](unsigned char ch) { return std::isdigit(ch); })) {
+        return false;
+    }
+    try {
+        value = std::stoi(text);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+    return value > 0;
+}
+
+bool is_image_file(const fs::path& path) {
+    static const char* extensions[] = {".png", ".jpg", ".jpeg", ".bmp", ".ppm", ".pgm", ".pnm", ".tif", ".tiff"};
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char ch) { return std::tolower(ch); });
+    return std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions);
+}
+
+bool has_glob_characters(const std::string& text) {
+    return text.find_first_of("*?[") != std::string::npos;
+}
+
+} // namespace
+
+size_spec size_spec::parse(const std::string& text) {
+    size_spec spec;
+    std::string::size_type x_pos = text.find('x');
+
+    if (x_pos != std::string::npos) {
+        // "WxH", "Wx" or "xH"
+        std::string width_text = text.substr(0, x_pos);
+        std::string height_text = text.substr(x_pos + 1);
+        bool width_ok = width_text.empty() || parse_positive_int(width_text, spec.width);
+        bool height_ok = height_text.empty() || parse_positive_int(height_text, spec.height);
+        if (!width_ok || !height_ok || (spec.width == 0 && spec.height == 0)) {
+            throw std::invalid_argument("invalid size '" + text + "'");
+        }
+        spec.label = text;
+        return spec;
+    }
+
+    // Plain scale factor or percentage
+    bool percent = !text.empty() && text.back() == '%';
+    std::string number = percent ? text.substr(0, text.size() - 1) : text;
+    std::size_t consumed = 0;
+    try {
+        spec.scale = std::stof(number, &consumed);
+    } catch (const std::exception&) {
+        consumed = 0;
+    }
+    if (consumed == 0 || consumed != number.size() || !(spec.scale > 0.0f)) {
+        throw std::invalid_argument("invalid size '" + text + "'");
+    }
+    if (percent) {
+        spec.scale /= 100.0f;
+    }
+
+    std::ostringstream label;
+    label << spec.scale;
+    spec.label = label.str();
+    return spec;
+}
+
+void size_spec::resolve(int source_width, int source_height, int& new_width, int& new_height) const {
+    // Range-checked before converting to int, so a huge scale cannot overflow. Scaled sides
+    // keep the float product that has always decided them, so existing output sizes stay put.
+    double result_width, result_height;
+    if (scale > 0.0f) {
+        result_width = std::floor(static_cast<double>(source_width * scale));
+        result_height = std::floor(static_cast<double>(source_height * scale));
+    } else if (width > 0 && height > 0) {
+        result_width = width;
+        result_height = height;
+    } else if (width > 0) {
+        result_width = width;
+        result_height = std::floor(static_cast<double>(source_height) * width / source_width);
+    } else {
+        result_height = height;
+        result_width = std::floor(static_cast<double>(source_width) * height / source_height);
+    }
+    if (!(result_width <= max_output_dimension) || !(result_height <= max_output_dimension)) {
+        throw std::invalid_argument("size '" + label + "' of a " + std::to_string(source_width) + "x" + std::to_string(source_height) +
+                                    " image exceeds " + std::to_string(max_output_dimension) + " pixels per side");
+    }
+    new_width = std::max(static_cast<int>(result_width), 1);
+    new_height = std::max(static_cast<int>(result_height), 1);
+}
+
+void apply_job_option(const std::string& option, resize_job& job) {
+    std::string::size_type equals = option.find('=');
+    std::string key = option.substr(0, equals);
+    std::string value = equals == std::string::npos ? std::string() : option.substr(equals + 1);
+    if (key == "png-level" && value.size() == 1 && std::isdigit(static_cast<unsigned char>(value[0]))) {
+        job.png.level = value[0] - '0';
+    } else if (key == "png-filter") {
+        job.png.filter = parse_png_filter(value);
+    } else {
+        throw std::invalid_argument("invalid option '" + option + "'");
+    }
+}
+
+std::vector<resize_job> load_manifest(const std::string& path, const png_options& png_defaults) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("cannot open manifest '" + path + "'");
+    }
+
+    std::vector<resize_job> jobs;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        std::string::size_type comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::istringstream fields(line);
+        std::string input, output, size, method, option;
+        if (!(fields >> input)) {
+            continue;
+        }
+        std::string location = path + ":" + std::to_string(line_number) + ": ";
+        if (!(fields >> output >> size >> method)) {
+            throw std::runtime_error(location + "expected 'input output size method [option=value...]'");
+        }
+
+        resize_job job;
+        job.input = input;
+        job.output = output;
+        job.method = method;
+        job.png = png_defaults;
+        try {
+            job.size = size_spec::parse(size);
+            while (fields >> option) {
+                apply_job_option(option, job);
+            }
+        } catch (const std::invalid_argument& e) {
+            throw std::runtime_error(location + e.what());
+        }
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+std::vector<std::string> expand_inputs(const std::vector<std::string>& inputs) {
+    std::vector<std::string> files;
+
+    for (const std::string& input : inputs) {
+        std::error_code error;
+        if (fs::is_directory(input, error)) {
+            std::vector<std::string> entries;
+            for (const fs::directory_entry& entry : fs::directory_iterator(input, error)) {
+                if (entry.is_regular_file(error) && is_image_file(entry.path())) {
+                    entries.push_back(entry.path().string());
+                }
+            }
+            std::sort(entries.begin(), entries.end());
+            files.insert(files.end(), entries.begin(), entries.end());
+        } else if (has_glob_characters(input)) {
+            glob_t matches;
+            if (glob(input.c_str(), 0, nullptr, &matches) == 0) {
+                for (std::size_t i = 0; i < matches.gl_pathc; ++i) {
+                    files.emplace_back(matches.gl_pathv[i]);
+                }
+            }
+            globfree(&matches);
+        } else {
+            // Missing files are reported as job failures rather than dropped here
+            files.push_back(input);
+        }
+    }
+    return files;
+}
+
+std::string default_output_path(const std::string& output_dir, const std::string& input, const std::string& method, const size_spec& size) {
+    std::string file_name = fs::path(input).stem().string() + "_resized_" + method + "_" + size.label + ".png";
+    if (output_dir.empty() || output_dir == ".") {
+        return file_name;
+    }
+    return (fs::path(output_dir) / file_name).string();
+}
@@ -0,0 +1,714 @@
+#include "batch_runner.h"
+#include "CImg.h"
+#include "allocation_tracking.h"
+#include "bounded_queue.h"
+#include "encoder_pool.h"
+#include "image_header.h"
+#include "memory_budget.h"
+#include "numa_topology.h"
+#include "pixel_copies.h"
+#include "resize_fanout.h"
+#include "resizer_factory.h"
+#include "task_scheduler.h"
+#include "tiled_tiff.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace cimg_library;
+
+namespace {
+
+bool is_tiff_path(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char ch) { return std::tolower(ch); });
+    return extension == ".tif" || extension == ".tiff";
+}
+
+std::string json_escape(const std::string& text) {
+    std::ostringstream escaped;
+    for (unsigned char ch : text) {
+        switch (ch) {
+        case '"': escaped << "\\\""; break;
+        case '\\': escaped << "\\\\"; break;
+        case '\n': escaped << "\\n"; break;
+        case '\t': escaped << "\\t"; break;
+        default:
+            if (ch < 0x20) {
+                escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(ch) << std::dec;
+            } else {
+                escaped << ch;
+            }
+        }
+    }
+    return escaped.str();
+}
+
+/**
+ * @brief A decoded input on its way from the decode stage to the resize stage.
+ */
+struct decoded_input {
+    std::size_t group = 0;
+    CImg<unsigned char> image;
+    cancellation_token cancel;
+    memory_reservation memory;
+
+    decoded_input() = default;
+    decoded_input(decoded_input&&) = default;
+    decoded_input& operator=(decoded_input&&) = default;
+    decoded_input(const decoded_input&) = delete;
+    decoded_input& operator=(const decoded_input&) = delete;
+};
+
+/**
+ * @brief Returns the bytes the output pool hands out for one output.
+ */
+std::size_t output_bytes(int width, int height, int channels) {
+    return buffer_pool::bucket_size(static_cast<std::size_t>(aligned_row_stride(width)) * height * channels);
+}
+
+/**
+ * @brief Estimates the peak memory of decoding an input and resizing it to every target.
+ *
+ * Decoding holds the decoder's rows next to the planar image, about the image again. The
+ * resize holds the image, every output and, per band, two cached rows of each output in
+ * floats and bytes; the outputs then wait for their encoders.
+ *
+ * @param decoded Whether the input is already decoded, so the decoder's rows are gone.
+ */
+std::size_t input_footprint(int width, int height, int channels, const std::vector<resize_target>& targets, std::size_t bands, bool decoded) {
+    std::size_t source = static_cast<std::size_t>(width) * height * channels;
+    std::size_t resize = 0;
+    for (const resize_target& target : targets) {
+        if (target.width > 0 && target.height > 0) {
+            std::size_t row = static_cast<std::size_t>(aligned_row_stride(target.width)) * channels;
+            resize += output_bytes(target.width, target.height, channels) + bands * 2 * row * (sizeof(float) + 1);
+        }
+    }
+    return source + std::max(decoded ? 0 : source, resize);
+}
+
+/**
+ * @brief Estimates the peak memory of a tiled TIFF job: the tiles and source windows being
+ * resized by every worker, plus the whole output unless it is written tile by tile.
+ */
+std::size_t tiled_footprint(const tiff_reader& reader, int new_width, int new_height, const tiled_resize_options& tiled,
+                            std::size_t workers, bool whole_output) {
+    double window_width = static_cast<double>(tiled.tile_width) * reader.width() / std::max(new_width, 1) + 2;
+    double window_height = static_cast<double>(tiled.tile_height) * reader.height() / std::max(new_height, 1) + 2;
+    double tile = static_cast<double>(tiled.tile_width) * tiled.tile_height + window_width * window_height;
+    std::size_t footprint = static_cast<std::size_t>(workers * tile * reader.channels());
+    return footprint + (whole_output ? output_bytes(new_width, new_height, reader.channels()) : 0);
+}
+
+unsigned long long elapsed_nanoseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void write_stage_json(std::ostream& out, const stage_stats& stage, double wall_seconds) {
+    out << "{\"threads\":" << stage.threads
+        << ",\"items\":" << stage.items
+        << ",\"busy_seconds\":" << stage.busy_seconds
+        << ",\"utilization\":" << stage.utilization(wall_seconds) << "}";
+}
+
+void add_allocations(allocation_counters& sum, const allocation_counters& counters) {
+    sum.bytes += counters.bytes;
+    sum.count += counters.count;
+    sum.peak_bytes = std::max(sum.peak_bytes, counters.peak_bytes);
+}
+
+void write_counters_json(std::ostream& out, const allocation_counters& counters) {
+    out << "\"bytes\":" << counters.bytes
+        << ",\"count\":" << counters.count
+        << ",\"peak_bytes\":" << counters.peak_bytes;
+}
+
+void write_allocations_json(std::ostream& out, const job_allocation_stats& allocations) {
+    write_counters_json(out, allocations.total);
+    out << ",\"decode\":{";
+    write_counters_json(out, allocations.decode);
+    out << "},\"resize\":{";
+    write_counters_json(out, allocations.resize);
+    out << "},\"encode\":{";
+    write_counters_json(out, allocations.encode);
+    out << "}";
+}
+
+void print_allocations(std::ostream& out, const job_allocation_stats& allocations) {
+    out << "decode " << allocations.decode.bytes / 1048576.0 << " MiB in " << allocations.decode.count << " allocations, "
+        << "resize intermediates " << allocations.resize.bytes / 1048576.0 << " MiB in " << allocations.resize.count << ", "
+        << "encode " << allocations.encode.bytes / 1048576.0 << " MiB in " << allocations.encode.count;
+}
+
+} // namespace
+
+double stage_stats::utilization(double wall_seconds) const {
+    return threads > 0 && wall_seconds > 0.0 ? std::min(1.0, busy_seconds / (threads * wall_seconds)) : 0.0;
+}
+
+double batch_stats::images_per_second() const {
+    return wall_seconds > 0.0 ? succeeded / wall_seconds : 0.0;
+}
+
+double batch_stats::megapixels_per_second() const {
+    return wall_seconds > 0.0 ? output_pixels / 1e6 / wall_seconds : 0.0;
+}
+
+void batch_stats::print_summary(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "Processed " << jobs << " jobs (" << succeeded << " succeeded, " << failed << " failed, " << cancelled << " cancelled) from "
+        << images_decoded << " decoded images in " << std::fixed << std::setprecision(3) << wall_seconds << " s" << std::endl;
+    out << "Throughput: " << std::setprecision(2) << images_per_second() << " images/s, "
+        << megapixels_per_second() << " MP/s" << std::endl;
+    out << "Stage utilization: " << std::setprecision(1)
+        << "decode " << 100.0 * decode.utilization(wall_seconds) << "% of " << decode.threads << " threads, "
+        << "resize " << 100.0 * resize.utilization(wall_seconds) << "% of " << resize.threads << ", "
+        << "encode " << 100.0 * encode.utilization(wall_seconds) << "% of " << encode.threads << std::endl;
+    out << "Output buffers: " << output_buffers.hits << " reused, " << output_buffers.misses << " allocated, "
+        << output_buffers.dropped << " freed over the cap; peak " << output_buffers.peak_retained_bytes / 1048576.0
+        << " MiB retained of " << output_buffers.max_retained_bytes / 1048576.0 << " MiB" << std::endl;
+    out << "Huge pages: " << huge_pages.allocations << " large buffers (" << huge_pages.bytes / 1048576.0 << " MiB) mapped on 2 MiB pages, "
+        << huge_pages.hugetlb << " from hugetlbfs, " << huge_pages.fallbacks << " fell back to THP" << std::endl;
+    out << "Memory budget: ";
+    if (memory.limit_bytes > 0) {
+        out << memory.limit_bytes / 1048576.0 << " MiB";
+    } else {
+        out << "unlimited";
+    }
+    out << ", peak " << memory.peak_reserved_bytes / 1048576.0 << " MiB reserved; " << memory.admitted << " inputs admitted, "
+        << memory.waited << " waited " << std::setprecision(3) << memory.wait_seconds << std::setprecision(1) << " s, "
+        << memory.oversized << " over budget ran alone" << std::endl;
+    out << "Pixel copies: " << pixel_bytes_copied / 1048576.0 << " MiB in explicit copies by " << jobs_copying << " of " << jobs
+        << " jobs" << std::endl;
+    out << "Allocations: peak " << allocations.total.peak_bytes / 1048576.0 << " MiB live for one input; ";
+    print_allocations(out, allocations);
+    out << std::endl;
+    out << "Scratch memory: " << scratch.allocations << " allocations served from " << scratch.blocks << " arena blocks ("
+        << std::setprecision(1) << scratch.block_bytes / 1048576.0 << " MiB), " << scratch.resets << " resets" << std::endl;
+    for (const std::string& error : errors) {
+        out << "  error: " << error << std::endl;
+    }
+    for (const std::string& plan : plans) {
+        out << "  plan: " << plan << std::endl;
+    }
+    for (const input_allocation_stats& input : input_allocations) {
+        out << "  allocations: " << input.input << ": peak " << input.allocations.total.peak_bytes / 1048576.0 << " MiB; ";
+        print_allocations(out, input.allocations);
+        out << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void batch_stats::write_json(std::ostream& out) const {
+    out << "{\"jobs\":" << jobs
+        << ",\"succeeded\":" << succeeded
+        << ",\"failed\":" << failed
+        << ",\"cancelled\":" << cancelled
+        << ",\"images_decoded\":" << images_decoded
+        << ",\"input_pixels\":" << input_pixels
+        << ",\"output_pixels\":" << output_pixels
+        << ",\"wall_seconds\":" << wall_seconds
+        << ",\"images_per_second\":" << images_per_second()
+        << ",\"megapixels_per_second\":" << megapixels_per_second()
+        << ",\"stages\":{\"decode\":";
+    write_stage_json(out, decode, wall_seconds);
+    out << ",\"resize\":";
+    write_stage_json(out, resize, wall_seconds);
+    out << ",\"encode\":";
+    write_stage_json(out, encode, wall_seconds);
+    out << "},\"scratch\":{\"allocations\":" << scratch.allocations
+        << ",\"bytes\":" << scratch.bytes
+        << ",\"blocks\":" << scratch.blocks
+        << ",\"block_bytes\":" << scratch.block_bytes
+        << ",\"resets\":" << scratch.resets
+        << "},\"output_buffers\":{\"hits\":" << output_buffers.hits
+        << ",\"misses\":" << output_buffers.misses
+        << ",\"dropped\":" << output_buffers.dropped
+        << ",\"peak_retained_bytes\":" << output_buffers.peak_retained_bytes
+        << ",\"max_retained_bytes\":" << output_buffers.max_retained_bytes
+        << "},\"huge_pages\":{\"allocations\":" << huge_pages.allocations
+        << ",\"bytes\":" << huge_pages.bytes
+        << ",\"hugetlb\":" << huge_pages.hugetlb
+        << ",\"fallbacks\":" << huge_pages.fallbacks
+        << "},\"memory_budget\":{\"limit_bytes\":" << memory.limit_bytes
+        << ",\"peak_reserved_bytes\":" << memory.peak_reserved_bytes
+        << ",\"admitted\":" << memory.admitted
+        << ",\"waited\":" << memory.waited
+        << ",\"wait_seconds\":" << memory.wait_seconds
+        << ",\"oversized\":" << memory.oversized
+        << "},\"pixel_copies\":{\"bytes\":" << pixel_bytes_copied
+        << ",\"jobs\":" << jobs_copying
+        << ",\"per_job\":[";
+    for (std::size_t i = 0; i < job_pixel_bytes_copied.size(); ++i) {
+        out << (i ? "," : "") << job_pixel_bytes_copied[i];
+    }
+    out << "]},\"allocations\":{";
+    write_allocations_json(out, allocations);
+    out << ",\"per_input\":[";
+    for (std::size_t i = 0; i < input_allocations.size(); ++i) {
+        out << (i ? "," : "") << "{\"input\":\"" << json_escape(input_allocations[i].input) << "\",";
+        write_allocations_json(out, input_allocations[i].allocations);
+        out << "}";
+    }
+    out << "]},\"errors\":[";
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+        out << (i ? "," : "") << '"' << json_escape(errors[i]) << '"';
+    }
+    out << "],\"plans\":[";
+    for (std::size_t i = 0; i < plans.size(); ++i) {
+        out << (i ? "," : "") << '"' << json_escape(plans[i]) << '"';
+    }
+    out << "]}" << std::endl;
+}
+
+batch_runner::batch_runner(const batch_options& options)
+    : options(options) {}
+
+batch_stats batch_runner::run(const std::vector<resize_job>& jobs) {
+    batch_stats stats;
+    stats.jobs = jobs.size();
+    std::mutex stats_mutex;
+
+    // Group jobs by input, keeping first-occurrence order, so each input is decoded once.
+    // TIFF inputs are never decoded whole; they go through the tiled path instead.
+    std::vector<std::vector<const resize_job*>> groups;
+    std::map<std::string, std::size_t> group_of_input;
+    std::vector<std::size_t> tiff_jobs;
+    for (const resize_job& job : jobs) {
+        if (is_tiff_path(job.input)) {
+            tiff_jobs.push_back(&job - jobs.data());
+            continue;
+        }
+        auto inserted = group_of_input.emplace(job.input, groups.size());
+        if (inserted.second) {
+            groups.emplace_back();
+        }
+        groups[inserted.first->second].push_back(&job);
+    }
+
+    auto fail = [&](const resize_job& job, const std::string& message) {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        ++stats.failed;
+        stats.errors.push_back(job.input + " -> " + job.output + ": " + message);
+    };
+
+    auto cancel_job = [&](const resize_job&) {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        ++stats.cancelled;
+    };
+
+    // Output pixels per job index, credited once the encoder has written the file
+    std::vector<unsigned long long> job_pixels(jobs.size(), 0);
+    std::vector<unsigned long long> job_copies(jobs.size(), 0);
+    auto copied = [&](std::size_t index, unsigned long long bytes) {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        job_copies[index] += bytes;
+    };
+    auto written = [&](std::size_t index, unsigned long long copied_bytes) {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        ++stats.succeeded;
+        stats.output_pixels += job_pixels[index];
+        job_copies[index] += copied_bytes;
+        if (options.log) {
+            const resize_job& job = jobs[index];
+            *options.log << "Image " << job.input << " resized using " << job.method << " to "
+                         << job.size.label << " and saved to " << job.output << std::endl;
+        }
+    };
+
+    // Allocations of each decoded input and each TIFF job, charged through allocation scopes.
+    // They outlive the encoders, which free the outputs under them.
+    std::vector<std::unique_ptr<job_allocations>> group_allocations;
+    for (std::size_t group = 0; group < groups.size(); ++group) {
+        group_allocations.push_back(std::make_unique<job_allocations>());
+    }
+    // Pixel copies made for a decoded input as a whole, before its outputs go separate ways;
+    // they are credited to the input's first job
+    std::vector<std::atomic<unsigned long long>> group_copies(groups.size());
+    std::vector<std::unique_ptr<job_allocations>> tiff_allocations;
+
+    huge_page_stats huge_pages_before = huge_page_resource::shared().stats();
+    auto start = std::chrono::steady_clock::now();
+    {
+        // Declared before the encoders, which hold its buffers and reservations until they are written
+        buffer_pool output_buffers(options.output_pool_bytes);
+        memory_budget budget(options.memory_budget_bytes);
+        // The encoders deflate PNG bands on the workers, so the scheduler outlives them
+        task_scheduler scheduler(options.workers, options.numa);
+        encoder_pool encoders(options.encoders, options.encode_queue, written, &scheduler);
+
+        // Decode stage: its own threads load the inputs in order and hand them to the resize
+        // stage through a bounded queue, blocking while the resizers are behind. With NUMA
+        // pinning every node has its own queue, and an input decoded (and so first touched)
+        // on a node is resized by that node's workers.
+        std::vector<std::unique_ptr<bounded_queue<decoded_input>>> decoded;
+        for (std::size_t node = 0; node < scheduler.node_count(); ++node) {
+            decoded.push_back(std::make_unique<bounded_queue<decoded_input>>(options.decode_queue));
+        }
+        std::atomic<std::size_t> next_group(0);
+        std::atomic<unsigned long long> decode_nanoseconds(0);
+        std::atomic<std::size_t> decode_count(0);
+        std::atomic<std::size_t> resize_count(0);
+        std::size_t tiff_resized = 0;
+
+        // Arenas for resize scratch, one per input in flight; a finished input resets its arena
+        // and returns it, so after warm-up the resize stage no longer touches the heap
+        std::mutex arenas_mutex;
+        std::vector<std::unique_ptr<arena>> arenas;
+        std::vector<arena*> free_arenas;
+        auto acquire_arena = [&]() -> arena* {
+            // An arena outlives the input that first needed it
+            allocation_scope untracked(nullptr);
+            std::lock_guard<std::mutex> lock(arenas_mutex);
+            if (free_arenas.empty()) {
+                arenas.push_back(std::make_unique<arena>());
+                return arenas.back().get();
+            }
+            arena* scratch = free_arenas.back();
+            free_arenas.pop_back();
+            return scratch;
+        };
+        auto release_arena = [&](arena* scratch) {
+            scratch->reset();
+            std::lock_guard<std::mutex> lock(arenas_mutex);
+            free_arenas.push_back(scratch);
+        };
+
+        // Resize stage: one scheduler task per decoded input; its fan-out bands are pushed onto
+        // the same worker's deque and stolen by idle workers, so one large image still uses
+        // every core. Outputs are handed to the encode stage, which blocks while it is behind.
+        auto resize_next = [&](std::size_t node) {
+            decoded_input popped;
+            decoded[node]->pop(popped);
+            // Opened before the input is moved in, so the input is freed under it as well
+            job_allocations& allocations = *group_allocations[popped.group];
+            allocation_scope resizing(allocations.phase(allocation_phase::resize));
+            pixel_copy_scope copies(&group_copies[popped.group]);
+            decoded_input item = std::move(popped);
+            const std::vector<const resize_job*>& group = groups[item.group];
+
+            // Resize all outputs of this input in one sweep over its rows
+            std::vector<const resize_job*> accepted;
+            std::vector<resize_target> targets;
+            for (const resize_job* job : group) {
+                if (!create_resizer(job->method)) {
+                    fail(*job, "unknown method '" + job->method + "'");
+                    continue;
+                }
+                resize_target target;
+                try {
+                    job->size.resolve(item.image.width(), item.image.height(), target.width, target.height);
+                } catch (const std::invalid_argument& e) {
+                    fail(*job, e.what());
+                    continue;
+                }
+                target.method = job->method;
+                targets.push_back(target);
+                accepted.push_back(job);
+            }
+
+            // A lone downscale can overwrite its own input instead of drawing a second buffer
+            if (options.in_place && targets.size() == 1 && targets[0].width > 0 && targets[0].height > 0 &&
+                targets[0].width <= item.image.width() && targets[0].height <= item.image.height()) {
+                if (options.debug_stats) {
+                    std::ostringstream plan;
+                    plan << group.front()->input << " (" << item.image.width() << "x" << item.image.height() << ", 1 target): in place";
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    stats.plans.push_back(plan.str());
+                }
+                // The output keeps occupying the whole source allocation until it is written
+                std::size_t source_bytes = item.image.size();
+                CImg<unsigned char> resized;
+                try {
+                    resized = create_resizer(targets[0].method)->resize_inplace(std::move(item.image), targets[0].width, targets[0].height,
+                                                                                 scheduler, item.cancel);
+                } catch (const operation_cancelled&) {
+                    cancel_job(*accepted[0]);
+                    return;
+                } catch (const std::exception& e) {
+                    fail(*accepted[0], e.what());
+                    return;
+                }
+                ++resize_count;
+                std::size_t index = accepted[0] - jobs.data();
+                job_pixels[index] = static_cast<unsigned long long>(targets[0].width) * targets[0].height;
+                allocation_scope encoding(allocations.phase(allocation_phase::encode));
+                encoders.submit(std::move(resized), accepted[0]->output, index, accepted[0]->png, item.memory.split(source_bytes));
+                return;
+            }
+
+            // Outputs are drawn from the pool and go back to it once the encoder has written them
+            std::vector<pooled_image> resized_images;
+            std::vector<mutable_image_view> outputs;
+            for (const resize_target& target : targets) {
+                if (target.width > 0 && target.height > 0) {
+                    resized_images.push_back(output_buffers.image(target.width, target.height, item.image.spectrum()));
+                    outputs.push_back(resized_images.back().pixels);
+                } else {
+                    resized_images.emplace_back();
+                    outputs.emplace_back();
+                }
+            }
+            arena* scratch = acquire_arena();
+            try {
+                if (options.debug_stats && !targets.empty()) {
+                    std::ostringstream plan;
+                    plan << group.front()->input << " (" << item.image.width() << "x" << item.image.height() << ", "
+                         << targets.size() << " targets): " << plan_fanout(item.image, targets, scheduler).describe();
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    stats.plans.push_back(plan.str());
+                }
+                resize_fanout_into(item.image, targets, outputs, scheduler, item.cancel, scratch);
+            } catch (const operation_cancelled&) {
+                release_arena(scratch);
+                item.image.assign();
+                for (const resize_job* job : accepted) {
+                    cancel_job(*job);
+                }
+                return;
+            } catch (const std::exception& e) {
+                release_arena(scratch);
+                for (const resize_job* job : accepted) {
+                    fail(*job, e.what());
+                }
+                return;
+            }
+            release_arena(scratch);
+            ++resize_count;
+            item.image.assign();
+
+            for (std::size_t i = 0; i < accepted.size(); ++i) {
+                std::size_t index = accepted[i] - jobs.data();
+                job_pixels[index] = static_cast<unsigned long long>(targets[i].width) * targets[i].height;
+                memory_reservation output_memory = item.memory.split(resized_images[i].buffer.capacity());
+                allocation_scope encoding(allocations.phase(allocation_phase::encode));
+                encoders.submit(std::move(resized_images[i]), accepted[i]->output, index, accepted[i]->png, std::move(output_memory));
+            }
+        };
+
+        // Estimated peak memory of an input group, from its decoded or header dimensions
+        auto group_footprint = [&](std::size_t group, int width, int height, int channels, bool decoded) {
+            std::vector<resize_target> targets;
+            for (const resize_job* job : groups[group]) {
+                resize_target target;
+                try {
+                    job->size.resolve(width, height, target.width, target.height);
+                } catch (const std::invalid_argument&) {
+                    // The resize stage fails the job; it needs no memory
+                    continue;
+                }
+                targets.push_back(target);
+            }
+            // An in-place resize only adds its pending band of about 1 MiB to the source
+            if (options.in_place && targets.size() == 1 && targets[0].width <= width && targets[0].height <= height) {
+                std::size_t source = static_cast<std::size_t>(width) * height * channels;
+                return source + std::max<std::size_t>(decoded ? 0 : source, 1 << 20);
+            }
+            return input_footprint(width, height, channels, targets, scheduler.size(), decoded);
+        };
+
+        std::vector<std::thread> decoders;
+        std::size_t decoder_count = std::max<std::size_t>(1, std::min(options.decoders, groups.size()));
+        for (std::size_t i = 0; i < decoder_count && !groups.empty(); ++i) {
+            decoders.emplace_back([&, i] {
+                std::size_t node = i % scheduler.node_count();
+                if (options.numa) {
+                    numa_topology::system().pin_current_thread(node);
+                }
+                for (std::size_t group = next_group++; group < groups.size(); group = next_group++) {
+                    allocation_scope decoding(group_allocations[group]->phase(allocation_phase::decode));
+                    pixel_copy_scope copies(&group_copies[group]);
+                    decoded_input item;
+                    item.group = group;
+                    item.cancel = options.cancel.child(options.job_deadline);
+                    const std::string& input = groups[group].front()->input;
+                    // Admission: the decoder waits until the input's estimated peak fits the budget.
+                    // Inputs whose header cannot be read are admitted as soon as they are decoded.
+                    image_header header;
+                    bool admitted = false;
+                    try {
+                        item.cancel.throw_if_cancelled();
+                        if (read_image_header(input, header)) {
+                            item.memory = budget.reserve(group_footprint(group, header.width, header.height, header.channels, false), item.cancel);
+                            admitted = true;
+                        }
+                    } catch (const operation_cancelled&) {
+                        for (const resize_job* job : groups[group]) {
+                            cancel_job(*job);
+                        }
+                        continue;
+                    }
+                    auto decode_start = std::chrono::steady_clock::now();
+                    try {
+                        item.image.load(input.c_str());
+                        if (!admitted) {
+                            item.memory = budget.reserve(group_footprint(group, item.image.width(), item.image.height(), item.image.spectrum(), true),
+                                                         item.cancel);
+                        }
+                    } catch (const operation_cancelled&) {
+                        decode_nanoseconds += elapsed_nanoseconds(decode_start);
+                        for (const resize_job* job : groups[group]) {
+                            cancel_job(*job);
+                        }
+                        continue;
+                    } catch (const std::exception& e) {
+                        decode_nanoseconds += elapsed_nanoseconds(decode_start);
+                        for (const resize_job* job : groups[group]) {
+                            fail(*job, e.what());
+                        }
+                        continue;
+                    }
+                    decode_nanoseconds += elapsed_nanoseconds(decode_start);
+                    ++decode_count;
+                    {
+                        std::lock_guard<std::mutex> lock(stats_mutex);
+                        ++stats.images_decoded;
+                        stats.input_pixels += static_cast<unsigned long long>(item.image.width()) * item.image.height();
+                    }
+                    // The resize task charges the input to its own scope once it has popped it
+                    allocation_scope untracked(nullptr);
+                    decoded[node]->push(std::move(item));
+                    scheduler.submit([&resize_next, node] { resize_next(node); }, node);
+                }
+            });
+        }
+        // TIFF jobs run on this thread while the decoders work. Each spreads its tiles over all
+        // workers, so they run one after another.
+        for (std::size_t index : tiff_jobs) {
+            tiff_allocations.push_back(std::make_unique<job_allocations>());
+            job_allocations& allocations = *tiff_allocations.back();
+            allocation_scope resizing(allocations.phase(allocation_phase::resize));
+            const resize_job& job = jobs[index];
+            cancellation_token job_cancel = options.cancel.child(options.job_deadline);
+            std::atomic<unsigned long long> tiff_copies(0);
+            pixel_copy_scope copies(&tiff_copies);
+            try {
+                job_cancel.throw_if_cancelled();
+                std::unique_ptr<resize_image_base> resizer = create_resizer(job.method);
+                if (!resizer) {
+                    throw std::invalid_argument("unknown method '" + job.method + "'");
+                }
+                tiff_reader reader(job.input);
+                {
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    ++stats.images_decoded;
+                    stats.input_pixels += static_cast<unsigned long long>(reader.width()) * reader.height();
+                }
+
+                int new_width = 0;
+                int new_height = 0;
+                job.size.resolve(reader.width(), reader.height(), new_width, new_height);
+                job_pixels[index] = static_cast<unsigned long long>(new_width) * new_height;
+                const tiled_resize_options& tiled = options.tiled;
+                memory_reservation memory = budget.reserve(tiled_footprint(reader, new_width, new_height, tiled, scheduler.size(), !is_tiff_path(job.output)),
+                                                           job_cancel);
+
+                if (is_tiff_path(job.output)) {
+                    std::filesystem::path parent = std::filesystem::path(job.output).parent_path();
+                    if (!parent.empty()) {
+                        std::filesystem::create_directories(parent);
+                    }
+                    try {
+                        tiff_writer writer(job.output, new_width, new_height, reader.channels(), tiled.tile_width, tiled.tile_height);
+                        resize_tiled(reader, *resizer, new_width, new_height, tiled, scheduler, [&](const image_rect& rect, const CImg<unsigned char>& tile) {
+                            allocation_scope encoding(allocations.phase(allocation_phase::encode));
+                            writer.write_tile(rect.x / tiled.tile_width, rect.y / tiled.tile_height, tile);
+                        }, job_cancel);
+                        allocation_scope encoding(allocations.phase(allocation_phase::encode));
+                        writer.finish();
+                    } catch (const operation_cancelled&) {
+                        // Leave no truncated TIFF behind
+                        std::error_code ignored;
+                        std::filesystem::remove(job.output, ignored);
+                        throw;
+                    }
+                    ++tiff_resized;
+                    written(index, 0);
+                } else {
+                    // Other formats need the whole output; every tile is resized straight into it
+                    pooled_image resized_image = output_buffers.image(new_width, new_height, reader.channels());
+                    resize_tiled(reader, *resizer, tiled, scheduler, resized_image.pixels, job_cancel);
+                    ++tiff_resized;
+                    allocation_scope encoding(allocations.phase(allocation_phase::encode));
+                    encoders.submit(std::move(resized_image), job.output, index, job.png, std::move(memory));
+                }
+            } catch (const operation_cancelled&) {
+                cancel_job(job);
+            } catch (const std::exception& e) {
+                fail(job, e.what());
+            }
+            copied(index, tiff_copies.load());
+        }
+
+        for (std::thread& decoder : decoders) {
+            decoder.join();
+        }
+        scheduler.wait_idle();
+        for (const encode_failure& failure : encoders.flush()) {
+            fail(jobs[failure.tag], failure.message);
+        }
+        for (std::size_t group = 0; group < groups.size(); ++group) {
+            copied(groups[group].front() - jobs.data(), group_copies[group].load());
+        }
+
+        stats.decode = stage_stats{decoders.size(), decode_count, decode_nanoseconds / 1e9};
+        // PNG bands the workers deflated are already in the encoders' busy time
+        stats.resize = stage_stats{scheduler.size(), resize_count + tiff_resized, scheduler.busy_seconds() - scheduler.lent_seconds()};
+        stats.encode = stage_stats{encoders.size(), encoders.encoded(), encoders.busy_seconds()};
+        for (const std::unique_ptr<arena>& scratch : arenas) {
+            stats.scratch += scratch->stats();
+        }
+        stats.output_buffers = output_buffers.stats();
+        stats.memory = budget.stats();
+        huge_page_stats huge_pages_after = huge_page_resource::shared().stats();
+        stats.huge_pages.allocations = huge_pages_after.allocations - huge_pages_before.allocations;
+        stats.huge_pages.bytes = huge_pages_after.bytes - huge_pages_before.bytes;
+        stats.huge_pages.hugetlb = huge_pages_after.hugetlb - huge_pages_before.hugetlb;
+        stats.huge_pages.fallbacks = huge_pages_after.fallbacks - huge_pages_before.fallbacks;
+    }
+    stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (unsigned long long bytes : job_copies) {
+        stats.pixel_bytes_copied += bytes;
+        stats.jobs_copying += bytes > 0;
+    }
+    if (options.debug_stats) {
+        stats.job_pixel_bytes_copied = std::move(job_copies);
+    }
+
+    // Inputs in order of their first job, merging the TIFF jobs in between the decoded inputs
+    auto add_input = [&](const std::string& input, const job_allocations& tracker) {
+        job_allocation_stats counted = tracker.stats();
+        add_allocations(stats.allocations.total, counted.total);
+        add_allocations(stats.allocations.decode, counted.decode);
+        add_allocations(stats.allocations.resize, counted.resize);
+        add_allocations(stats.allocations.encode, counted.encode);
+        if (options.debug_stats) {
+            stats.input_allocations.push_back(input_allocation_stats{input, counted});
+        }
+    };
+    std::size_t next_tiff = 0;
+    for (std::size_t group = 0; group <= groups.size(); ++group) {
+        std::size_t first_job = group < groups.size() ? static_cast<std::size_t>(groups[group].front() - jobs.data()) : jobs.size();
+        for (; next_tiff < tiff_allocations.size() && tiff_jobs[next_tiff] < first_job; ++next_tiff) {
+            const resize_job& job = jobs[tiff_jobs[next_tiff]];
+            add_input(job.input + " -> " + job.output, *tiff_allocations[next_tiff]);
+        }
+        if (group < groups.size()) {
+            add_input(groups[group].front()->input, *group_allocations[group]);
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,105 @@
+#include "buffer_pool.h"
+#include "allocation_tracking.h"
+#include "huge_pages.h"
+#include "output_poison.h"
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+using namespace cimg_library;
+
+pooled_buffer::pooled_buffer(pooled_buffer&& other) noexcept
+    : pool(std::exchange(other.pool, nullptr)), bytes(std::exchange(other.bytes, nullptr)), bucket(std::exchange(other.bucket, 0)) {}
+
+pooled_buffer& pooled_buffer::operator=(pooled_buffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool = std::exchange(other.pool, nullptr);
+        bytes = std::exchange(other.bytes, nullptr);
+        bucket = std::exchange(other.bucket, 0);
+    }
+    return *this;
+}
+
+void pooled_buffer::release() {
+    if (bytes) {
+        pool->give_back(bytes, bucket);
+    }
+    pool = nullptr;
+    bytes = nullptr;
+    bucket = 0;
+}
+
+buffer_pool::buffer_pool(std::size_t max_retained_bytes) {
+    counters.max_retained_bytes = max_retained_bytes;
+}
+
+buffer_pool::~buffer_pool() {
+    for (auto& bucket : free_buffers) {
+        for (unsigned char* bytes : bucket.second) {
+            huge_page_resource::shared().deallocate(bytes, bucket.first, image_row_alignment);
+        }
+    }
+}
+
+std::size_t buffer_pool::bucket_size(std::size_t bytes) {
+    const std::size_t smallest = 4096;
+    if (bytes <= smallest) {
+        return smallest;
+    }
+    // Sizes in (2^k, 2^(k+1)] round up to a multiple of 2^(k-2)
+    std::size_t step = std::size_t(1) << (std::bit_width(bytes - 1) - 3);
+    return (bytes + step - 1) / step * step;
+}
+
+pooled_buffer buffer_pool::acquire(std::size_t bytes) {
+    std::size_t bucket = bucket_size(bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = free_buffers.find(bucket);
+        if (found != free_buffers.end() && !found->second.empty()) {
+            unsigned char* recycled = found->second.back();
+            found->second.pop_back();
+            counters.retained_bytes -= bucket;
+            ++counters.hits;
+            // Allocation tracking charges a buffer as one bucket, whether recycled or fresh
+            note_allocation(bucket);
+            return pooled_buffer(this, recycled, bucket);
+        }
+        ++counters.misses;
+    }
+    note_allocation(bucket);
+    allocation_scope untracked(nullptr);
+    return pooled_buffer(this, static_cast<unsigned char*>(huge_page_resource::shared().allocate(bucket, image_row_alignment)), bucket);
+}
+
+pooled_image buffer_pool::image(int width, int height, int channels) {
+    pooled_image result;
+    std::ptrdiff_t stride = aligned_row_stride(width);
+    result.buffer = acquire(static_cast<std::size_t>(stride) * height * channels);
+    result.pixels = mutable_image_view::aligned(result.buffer.data(), width, height, channels, stride);
+    // A recycled buffer still holds its previous image, which would hide missed pixels
+    poison_output(result.pixels);
+    return result;
+}
+
+buffer_pool_stats buffer_pool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void buffer_pool::give_back(unsigned char* bytes, std::size_t bucket) {
+    note_deallocation(bucket);
+    allocation_scope untracked(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (counters.retained_bytes + bucket <= counters.max_retained_bytes) {
+            free_buffers[bucket].push_back(bytes);
+            counters.retained_bytes += bucket;
+            counters.peak_retained_bytes = std::max(counters.peak_retained_bytes, counters.retained_bytes);
+            return;
+        }
+        ++counters.dropped;
+    }
+    huge_page_resource::shared().deallocate(bytes, bucket, image_row_alignment);
+}
@@ -0,0 +1,40 @@
+#include "cancellation_token.h"
+
+cancellation_token cancellation_token::create() {
+    cancellation_token token;
+    token.shared = std::make_shared<state>();
+    return token;
+}
+
+cancellation_token cancellation_token::with_deadline(clock::time_point deadline) {
+    cancellation_token token = create();
+    token.shared->deadline = deadline;
+    return token;
+}
+
+cancellation_token cancellation_token::child(clock::duration timeout) const {
+    cancellation_token token = create();
+    token.shared->parent = shared;
+    if (timeout > clock::duration::zero()) {
+        token.shared->deadline = clock::now() + timeout;
+    }
+    return token;
+}
+
+void cancellation_token::cancel() const {
+    if (shared) {
+        shared->cancelled.store(true, std::memory_order_relaxed);
+    }
+}
+
+bool cancellation_token::is_cancelled() const {
+    for (const state* link = shared.get(); link; link = link->parent.get()) {
+        if (link->cancelled.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (link->deadline != clock::time_point::max() && clock::now() >= link->deadline) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,94 @@
+#include "encoder_pool.h"
+#include "allocation_tracking.h"
+#include "pixel_copies.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace cimg_library;
+
+encoder_pool::encoder_pool(std::size_t thread_count, std::size_t queue_capacity,
+                           std::function<void(std::size_t tag, unsigned long long copied_bytes)> on_written, task_scheduler* scheduler)
+    : queue(queue_capacity), on_written(std::move(on_written)), scheduler(scheduler) {
+    thread_count = std::max<std::size_t>(thread_count, 1);
+    workers.reserve(thread_count);
+    for (std::size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+encoder_pool::~encoder_pool() {
+    queue.close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void encoder_pool::submit(CImg<unsigned char>&& image, std::string path, std::size_t tag, const png_options& png, memory_reservation memory) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++in_flight;
+    }
+    queue.push(encode_item(std::move(image), std::move(path), tag, png, pooled_image(), std::move(memory), allocation_scope::current()));
+}
+
+void encoder_pool::submit(pooled_image&& image, std::string path, std::size_t tag, const png_options& png, memory_reservation memory) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++in_flight;
+    }
+    queue.push(encode_item(CImg<unsigned char>(), std::move(path), tag, png, std::move(image), std::move(memory), allocation_scope::current()));
+}
+
+std::vector<encode_failure> encoder_pool::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [this] { return in_flight == 0; });
+    std::vector<encode_failure> result;
+    result.swap(failures);
+    return result;
+}
+
+void encoder_pool::worker_loop() {
+    // pop() drains the queue before reporting the close, so no submitted image is lost
+    encode_item item;
+    while (queue.pop(item)) {
+        auto start = std::chrono::steady_clock::now();
+        allocation_scope allocations(item.allocations);
+        std::string error;
+        std::atomic<unsigned long long> copied(0);
+        try {
+            pixel_copy_scope copies(&copied);
+            image_view pixels = item.pooled.buffer.data() ? image_view(item.pooled.pixels) : image_view(item.image);
+            if (scheduler) {
+                write_image(pixels, item.path, item.png, *scheduler);
+            } else {
+                png_options serial = item.png;
+                serial.threads = 1;
+                write_image(pixels, item.path, serial);
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+            if (error.empty()) {
+                error = "write failed";
+            }
+        }
+        if (error.empty() && on_written) {
+            on_written(item.tag, copied.load());
+        }
+        // Release the pixels before waiting for the next image; pooled ones are recycled
+        item.image.assign();
+        item.pooled.buffer.release();
+        item.memory.release();
+        busy_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        ++items_done;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error.empty()) {
+            failures.push_back(encode_failure{item.tag, std::move(item.path), std::move(error)});
+        }
+        // The path too is freed while the item's allocation scope is current
+        item.path = std::string();
+        if (--in_flight == 0) {
+            drained.notify_all();
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#include "huge_pages.h"
+#include "allocation_tracking.h"
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+
+namespace {
+
+/**
+ * @brief Maps length bytes (a multiple of the huge page size) on a huge-page boundary.
+ *
+ * Over-maps by one huge page and trims both ends, since mmap only guarantees 4 KiB alignment.
+ */
+void* map_aligned(std::size_t length) {
+    const std::size_t page = huge_page_resource::huge_page_size;
+    void* raw = mmap(nullptr, length + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw);
+    std::uintptr_t aligned = (start + page - 1) & ~(static_cast<std::uintptr_t>(page) - 1);
+    if (aligned > start) {
+        munmap(raw, aligned - start);
+    }
+    std::size_t tail = start + length + page - (aligned + length);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + length), tail);
+    }
+    // Only a hint: the kernel may still use 4 KiB pages when THP is disabled or memory is fragmented
+    madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+    return reinterpret_cast<void*>(aligned);
+}
+
+} // namespace
+
+huge_page_mode parse_huge_page_mode(const std::string& name) {
+    if (name == "off") {
+        return huge_page_mode::off;
+    }
+    if (name == "thp") {
+        return huge_page_mode::transparent;
+    }
+    if (name == "hugetlb") {
+        return huge_page_mode::hugetlb;
+    }
+    throw std::invalid_argument("unknown huge page mode '" + name + "' (expected off, thp or hugetlb)");
+}
+
+huge_page_resource::huge_page_resource(huge_page_mode mode, std::size_t threshold, std::pmr::memory_resource* upstream)
+    : mode(mode), threshold(threshold), upstream(upstream),
+      smallest_mapped(mode == huge_page_mode::off ? std::numeric_limits<std::size_t>::max() : threshold) {}
+
+huge_page_resource::~huge_page_resource() {
+    for (const auto& mapping : mappings) {
+        munmap(mapping.first, mapping.second);
+    }
+}
+
+huge_page_resource& huge_page_resource::shared() {
+    // Never destroyed: static objects destroyed after it would otherwise free into a dead
+    // map. Built in place, since operator new itself comes here.
+    alignas(huge_page_resource) static unsigned char storage[sizeof(huge_page_resource)];
+    static huge_page_resource& resource = *::new (storage) huge_page_resource();
+    return resource;
+}
+
+void huge_page_resource::configure(huge_page_mode new_mode, std::size_t new_threshold) {
+    std::lock_guard<std::mutex> lock(mutex);
+    mode = new_mode;
+    threshold = new_threshold;
+    smallest_mapped = mode == huge_page_mode::off ? std::numeric_limits<std::size_t>::max() : threshold;
+}
+
+huge_page_stats huge_page_resource::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void* huge_page_resource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    void* pointer = map(bytes, alignment);
+    return pointer ? pointer : upstream->allocate(bytes, alignment);
+}
+
+void huge_page_resource::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) {
+    if (!unmap(pointer)) {
+        upstream->deallocate(pointer, bytes, alignment);
+    }
+}
+
+void* huge_page_resource::map(std::size_t bytes, std::size_t alignment) {
+    if (bytes < smallest_mapped.load(std::memory_order_relaxed) || alignment > huge_page_size) {
+        return nullptr;
+    }
+    huge_page_mode current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = mode;
+        if (mode == huge_page_mode::off || bytes < threshold) {
+            return nullptr;
+        }
+    }
+
+    std::size_t length = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    void* pointer = nullptr;
+    bool from_pool = false;
+    if (current == huge_page_mode::hugetlb) {
+        pointer = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        from_pool = pointer != MAP_FAILED;
+    }
+    if (!from_pool) {
+        pointer = map_aligned(length);
+    }
+    note_allocation(length);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    mappings.emplace(pointer, length);
+    ++counters.allocations;
+    counters.bytes += length;
+    if (from_pool) {
+        ++counters.hugetlb;
+    } else if (current == huge_page_mode::hugetlb) {
+        ++counters.fallbacks;
+    }
+    return pointer;
+}
+
+bool huge_page_resource::unmap(void* pointer) {
+    // Mappings are looked up rather than inferred from the size, so configure() may change
+    // the threshold while allocations are live
+    std::size_t length = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = mappings.find(pointer);
+        if (found == mappings.end()) {
+            return false;
+        }
+        length = found->second;
+        mappings.erase(found);
+    }
+    note_deallocation(length);
+    munmap(pointer, length);
+    return true;
+}
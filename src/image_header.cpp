@@ -0,0 +1,134 @@
+#include "image_header.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+std::uint32_t big_endian(const unsigned char* bytes, int count) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < count; ++i) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+std::uint32_t little_endian(const unsigned char* bytes, int count) {
+    std::uint32_t value = 0;
+    for (int i = count - 1; i >= 0; --i) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+bool read_png(std::ifstream& file, image_header& header) {
+    // Signature, IHDR length and type, then width, height, bit depth and colour type
+    unsigned char bytes[26];
+    if (!file.read(reinterpret_cast<char*>(bytes), sizeof(bytes)) || std::memcmp(bytes + 12, "IHDR", 4) != 0) {
+        return false;
+    }
+    header.width = static_cast<int>(big_endian(bytes + 16, 4));
+    header.height = static_cast<int>(big_endian(bytes + 20, 4));
+    switch (bytes[25]) {
+    case 0: header.channels = 1; break;
+    case 2: header.channels = 3; break;
+    case 3: header.channels = 4; break;
+    case 4: header.channels = 2; break;
+    case 6: header.channels = 4; break;
+    default: return false;
+    }
+    return true;
+}
+
+bool read_jpeg(std::ifstream& file, image_header& header) {
+    file.seekg(2);
+    unsigned char marker[4];
+    while (file.read(reinterpret_cast<char*>(marker), 2)) {
+        if (marker[0] != 0xFF) {
+            return false;
+        }
+        // Fill bytes and markers without a length
+        if (marker[1] == 0xFF) {
+            file.seekg(-1, std::ios::cur);
+            continue;
+        }
+        if (marker[1] == 0x01 || (marker[1] >= 0xD0 && marker[1] <= 0xD8)) {
+            continue;
+        }
+        if (!file.read(reinterpret_cast<char*>(marker + 2), 2)) {
+            return false;
+        }
+        std::uint32_t length = big_endian(marker + 2, 2);
+        // Start of frame: every SOFn except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker[1] >= 0xC0 && marker[1] <= 0xCF && marker[1] != 0xC4 && marker[1] != 0xC8 && marker[1] != 0xCC) {
+            unsigned char frame[6];
+            if (!file.read(reinterpret_cast<char*>(frame), sizeof(frame))) {
+                return false;
+            }
+            header.height = static_cast<int>(big_endian(frame + 1, 2));
+            header.width = static_cast<int>(big_endian(frame + 3, 2));
+            header.channels = frame[5];
+            return true;
+        }
+        if (length < 2) {
+            return false;
+        }
+        file.seekg(length - 2, std::ios::cur);
+    }
+    return false;
+}
+
+bool read_bmp(std::ifstream& file, image_header& header) {
+    unsigned char bytes[26];
+    if (!file.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+        return false;
+    }
+    header.width = static_cast<int>(little_endian(bytes + 18, 4));
+    header.height = static_cast<int>(little_endian(bytes + 22, 4));
+    // Bottom-up and top-down BMPs differ in the sign of the height
+    header.height = header.height < 0 ? -header.height : header.height;
+    header.channels = 3;
+    return true;
+}
+
+bool read_pnm(std::ifstream& file, image_header& header, char kind) {
+    file.seekg(2);
+    int values[2];
+    for (int& value : values) {
+        file >> std::ws;
+        while (file.peek() == '#') {
+            file.ignore(1 << 16, '\n');
+            file >> std::ws;
+        }
+        if (!(file >> value)) {
+            return false;
+        }
+    }
+    header.width = values[0];
+    header.height = values[1];
+    header.channels = kind == '6' ? 3 : 1;
+    return true;
+}
+
+} // namespace
+
+bool read_image_header(const std::string& path, image_header& header) {
+    std::ifstream file(path, std::ios::binary);
+    unsigned char magic[8] = {};
+    if (!file.read(reinterpret_cast<char*>(magic), 2)) {
+        return false;
+    }
+    bool found = false;
+    if (magic[0] == 0x89 && magic[1] == 'P') {
+        file.seekg(0);
+        found = read_png(file, header);
+    } else if (magic[0] == 0xFF && magic[1] == 0xD8) {
+        found = read_jpeg(file, header);
+    } else if (magic[0] == 'B' && magic[1] == 'M') {
+        file.seekg(0);
+        found = read_bmp(file, header);
+    } else if (magic[0] == 'P' && magic[1] >= '4' && magic[1] <= '6') {
+        found = read_pnm(file, header, static_cast<char>(magic[1]));
+    }
+    return found && header.width > 0 && header.height > 0 && header.channels > 0;
+}
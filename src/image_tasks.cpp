@@ -0,0 +1,20 @@
+#include "image_tasks.h"
+
+using namespace cimg_library;
+
+task<CImg<unsigned char>> load_task(std::string path, task_scheduler& scheduler) {
+    co_await schedule_on(scheduler);
+    CImg<unsigned char> image;
+    image.load(path.c_str());
+    co_return image;
+}
+
+task<CImg<unsigned char>> resize_task(const resize_image_base& resizer, CImg<unsigned char> source,
+                                      int new_width, int new_height, task_scheduler& scheduler, cancellation_token cancel) {
+    co_return co_await resizer.resize_async(std::move(source), new_width, new_height, scheduler, cancel);
+}
+
+task<void> save_task(CImg<unsigned char> image, std::string path, png_options png, task_scheduler& scheduler) {
+    co_await schedule_on(scheduler);
+    write_image(image, path, png, scheduler);
+}
@@ -1,57 +1,294 @@
 #include "CImg.h"
-#include "resize_nearest_neighbour.h"
-#include "resize_bilinear.h"
-#include <sstream>
+#include "batch_job.h"
+#include "batch_runner.h"
+#include "huge_pages.h"
+#include "output_poison.h"
+#include "pipe_server.h"
+#include "resizer_factory.h"
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace cimg_library;
 
+namespace {
+
 /**
- * @brief Resizes an image using the specified resizer and saves the result.
- * 
- * @param resizer The resizer object that implements the resize method.
- * @param image The original image to be resized.
- * @param scale_factor The factor by which to scale the image.
- * @param method The name of the resizing method (used for output filename and logging).
+ * @brief Command-line settings of one invocation.
  */
-void resize_and_save(const resize_image_base& resizer, const CImg<unsigned char>& image, float scale_factor, const std::string& method) {
-    // Calculate new dimensions based on the scale factor
-    int new_width = static_cast<int>(image.width() * scale_factor);
-    int new_height = static_cast<int>(image.height() * scale_factor);
+struct cli_options {
+    std::vector<std::string> inputs;
+    std::vector<std::string> sizes;
+    std::vector<std::string> methods;
+    std::string manifest;
+    std::string output_dir = ".";
+    std::string stats_json;
+    std::size_t workers = 0;
+    std::size_t decoders = 2;
+    std::size_t decode_queue = 4;
+    std::size_t encoders = 2;
+    std::size_t encode_queue = 8;
+    std::size_t buffer_pool_mb = 256;
+    bool in_place = false;
+    std::size_t memory_mb = 0;
+    huge_page_mode huge_pages = huge_page_mode::transparent;
+    std::size_t huge_page_threshold_mb = 4;
+    bool numa = false;
+    long deadline_ms = 0;
+    bool debug_stats = false;
+    bool poison_outputs = false;
+    png_options png;
+    int tile_size = 256;
+    bool pipe = false;
+    bool quiet = false;
+};
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <input>...\n"
+              << "       " << program << " --pipe [options] < requests > responses\n"
+              << "\n"
+              << "Inputs may be image files, directories or quoted glob patterns.\n"
+              << "Without inputs or a manifest, src/lenna.png is resized by 0.5, 0.75, 1.5 and 2.\n"
+              << "\n"
+              << "Options:\n"
+              << "  -m, --manifest FILE    read jobs from FILE, one 'input output size method [png-level=N] [png-filter=NAME]'\n"
+              << "                         per line\n"
+              << "  -s, --size SPEC        target size: WxH, Wx, xH, a scale (0.5) or a percentage (50%); repeatable\n"
+              << "  -M, --method NAME      nearest, bilinear or all (default all); repeatable\n"
+              << "  -o, --output-dir DIR   directory for generated output names (default .)\n"
+              << "  -j, --jobs N           number of resize worker threads (default: all cores)\n"
+              << "      --decoders N       number of decoder threads (default 2)\n"
+              << "      --decode-queue N   decoded inputs that may wait for a worker (default 4)\n"
+              << "      --encoders N       number of encoder/writer threads (default 2)\n"
+              << "      --encode-queue N   outputs that may wait for an encoder (default 8)\n"
+              << "      --pool-mb N        most memory kept for reusing output buffers (default 256)\n"
+              << "      --in-place         resize an input with one smaller output inside its own buffer\n"
+              << "      --memory-mb N      admit inputs only while their estimated memory fits N MiB (default: no limit)\n"
+              << "      --huge-pages MODE  back large buffers with off, thp (default) or hugetlb pages\n"
+              << "      --huge-min-mb N    smallest buffer put on huge pages (default 4)\n"
+              << "      --numa             pin decoders and workers per NUMA node and keep each input on one node\n"
+              << "      --deadline-ms N    cancel the jobs of an input N ms after its decode starts (default: no deadline)\n"
+              << "      --png-level N      PNG compression level 0-9 (default 6)\n"
+              << "      --png-filter NAME  none, sub, up, average, paeth or adaptive (default adaptive)\n"
+              << "      --png-threads N    threads deflating one PNG in parallel (default: all workers)\n"
+              << "      --tile-size N      output tile size for TIFF inputs, a multiple of 16 (default 256)\n"
+              << "      --stats-json FILE  write the batch statistics as JSON to FILE ('-' for stdout)\n"
+              << "      --debug-stats      include the parallel plan chosen for each input in the statistics\n"
+              << "      --poison-outputs   fill new output buffers with 0xA5 before resizing, to expose unwritten pixels\n"
+              << "      --pipe             serve framed requests from stdin and answer on stdout (see pipe_server.h)\n"
+              << "  -q, --quiet            do not log each finished job\n"
+              << "  -h, --help             show this help\n";
+}
 
-    // Resize the image using the specified resizer
-    CImg<unsigned char> resized_image = resizer.resize(image, new_width, new_height);
+cli_options parse_arguments(int argc, char** argv) {
+    cli_options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
 
-    // Create the output filename based on the method and scale factor
-    std::ostringstream output_filename;
-    output_filename << "lenna_resized_" << method << "_" << scale_factor << ".png";
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            std::exit(0);
+        } else if (arg == "-m" || arg == "--manifest") {
+            options.manifest = value();
+        } else if (arg == "-s" || arg == "--size") {
+            options.sizes.push_back(value());
+        } else if (arg == "-M" || arg == "--method") {
+            options.methods.push_back(value());
+        } else if (arg == "-o" || arg == "--output-dir") {
+            options.output_dir = value();
+        } else if (arg == "-j" || arg == "--jobs") {
+            options.workers = std::stoul(value());
+        } else if (arg == "--decoders") {
+            options.decoders = std::stoul(value());
+        } else if (arg == "--decode-queue") {
+            options.decode_queue = std::stoul(value());
+        } else if (arg == "--encoders") {
+            options.encoders = std::stoul(value());
+        } else if (arg == "--encode-queue") {
+            options.encode_queue = std::stoul(value());
+        } else if (arg == "--pool-mb") {
+            options.buffer_pool_mb = std::stoul(value());
+        } else if (arg == "--in-place") {
+            options.in_place = true;
+        } else if (arg == "--memory-mb") {
+            options.memory_mb = std::stoul(value());
+        } else if (arg == "--huge-pages") {
+            options.huge_pages = parse_huge_page_mode(value());
+        } else if (arg == "--huge-min-mb") {
+            options.huge_page_threshold_mb = std::stoul(value());
+        } else if (arg == "--numa") {
+            options.numa = true;
+        } else if (arg == "--deadline-ms") {
+            options.deadline_ms = std::stol(value());
+        } else if (arg == "--png-level") {
+            options.png.level = std::stoi(value());
+        } else if (arg == "--png-filter") {
+            options.png.filter = parse_png_filter(value());
+        } else if (arg == "--png-threads") {
+            options.png.threads = std::stoul(value());
+        } else if (arg == "--tile-size") {
+            options.tile_size = std::stoi(value());
+            if (options.tile_size <= 0 || options.tile_size % 16 != 0) {
+                throw std::invalid_argument("--tile-size must be a positive multiple of 16");
+            }
+        } else if (arg == "--stats-json") {
+            options.stats_json = value();
+        } else if (arg == "--debug-stats") {
+            options.debug_stats = true;
+        } else if (arg == "--poison-outputs") {
+            options.poison_outputs = true;
+        } else if (arg == "--pipe") {
+            options.pipe = true;
+        } else if (arg == "-q" || arg == "--quiet") {
+            options.quiet = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            throw std::invalid_argument("unknown option " + arg);
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+    return options;
+}
 
-    // Save the resized image to the output file
-    resized_image.save(output_filename.str().c_str());
+/**
+ * @brief Builds the job list from the manifest and/or the inputs crossed with sizes and methods.
+ */
+std::vector<resize_job> build_jobs(cli_options& options) {
+    std::vector<resize_job> jobs;
+    if (!options.manifest.empty()) {
+        jobs = load_manifest(options.manifest, options.png);
+    }
+
+    // Keep the original demo behaviour when nothing was requested
+    if (options.inputs.empty() && options.manifest.empty()) {
+        options.inputs = {"src/lenna.png"};
+        if (options.sizes.empty()) {
+            options.sizes = {"0.5", "0.75", "1.5", "2"};
+        }
+    }
+    if (options.inputs.empty()) {
+        return jobs;
+    }
+
+    if (options.sizes.empty()) {
+        throw std::invalid_argument("no --size given for the inputs");
+    }
+    std::vector<std::string> methods;
+    for (const std::string& method : options.methods) {
+        if (method == "all") {
+            methods.insert(methods.end(), resizer_methods().begin(), resizer_methods().end());
+        } else {
+            methods.push_back(method);
+        }
+    }
+    if (methods.empty()) {
+        methods = resizer_methods();
+    }
 
-    // Log the resizing operation details
-    std::cout << "Image resized using " << method << " to " << scale_factor * 100 << "% and saved to " << output_filename.str() << std::endl;
-    std::cout << "New dimensions: " << resized_image.width() << "x" << resized_image.height() << std::endl;
+    std::vector<size_spec> sizes;
+    for (const std::string& size : options.sizes) {
+        sizes.push_back(size_spec::parse(size));
+    }
+
+    for (const std::string& input : expand_inputs(options.inputs)) {
+        for (const size_spec& size : sizes) {
+            for (const std::string& method : methods) {
+                resize_job job;
+                job.input = input;
+                job.size = size;
+                job.method = method;
+                job.png = options.png;
+                job.output = default_output_path(options.output_dir, input, method, size);
+                jobs.push_back(std::move(job));
+            }
+        }
+    }
+    return jobs;
 }
 
-int main() {
-    // Load the original image from file
-    CImg<unsigned char> image("src/lenna.png");
+// Cancelled by SIGINT; created before the handler is installed and never reassigned
+cancellation_token interrupt_token;
+
+extern "C" void on_interrupt(int) {
+    interrupt_token.cancel();
+    // A second Ctrl-C terminates immediately
+    std::signal(SIGINT, SIG_DFL);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    cli_options options;
+    std::vector<resize_job> jobs;
+    try {
+        options = parse_arguments(argc, argv);
+        if (!options.pipe) {
+            jobs = build_jobs(options);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    // Errors are reported per job in the summary instead of on stderr as they happen
+    cimg::exception_mode(0);
+
+    huge_page_resource::shared().configure(options.huge_pages, options.huge_page_threshold_mb << 20);
+    if (options.poison_outputs) {
+        set_output_poisoning(true);
+    }
+
+    // In pipe mode stdout carries only response frames, so the log goes to stderr
+    if (options.pipe) {
+        pipe_server server(options.png, options.quiet ? nullptr : &std::cerr);
+        return server.serve(stdin, stdout);
+    }
+
+    batch_options settings;
+    settings.workers = options.workers;
+    settings.decoders = options.decoders;
+    settings.decode_queue = options.decode_queue;
+    settings.encoders = options.encoders;
+    settings.encode_queue = options.encode_queue;
+    settings.output_pool_bytes = options.buffer_pool_mb << 20;
+    settings.in_place = options.in_place;
+    settings.memory_budget_bytes = options.memory_mb << 20;
+    settings.numa = options.numa;
+    settings.job_deadline = std::chrono::milliseconds(options.deadline_ms);
+    settings.debug_stats = options.debug_stats;
+    settings.tiled.tile_width = options.tile_size;
+    settings.tiled.tile_height = options.tile_size;
+    settings.log = options.quiet ? nullptr : &std::cout;
 
-    // Create resizer objects for nearest neighbour and bilinear methods
-    resize_nearest_neighbour nearest_neighbour_resizer;
-    resize_bilinear bilinear_resizer;
+    // Ctrl-C stops the remaining jobs at their next row band; the summary is still printed
+    interrupt_token = cancellation_token::create();
+    settings.cancel = interrupt_token;
+    std::signal(SIGINT, on_interrupt);
 
-    // Scale factors to apply
-    float scale_factors[] = {0.5, 0.75, 1.5, 2.0};
+    batch_runner runner(settings);
+    batch_stats stats = runner.run(jobs);
+    stats.print_summary(std::cout);
 
-    // Loop through each scale factor and resize the image using both methods
-    for (float scale_factor : scale_factors) {
-        // Resize and save using nearest neighbour method
-        resize_and_save(nearest_neighbour_resizer, image, scale_factor, "nearest");
-        // Resize and save using bilinear method
-        resize_and_save(bilinear_resizer, image, scale_factor, "bilinear");
+    if (!options.stats_json.empty()) {
+        if (options.stats_json == "-") {
+            stats.write_json(std::cout);
+        } else {
+            std::ofstream stats_file(options.stats_json);
+            stats.write_json(stats_file);
+        }
     }
 
-    return 0;
+    return stats.failed == 0 && stats.cancelled == 0 ? 0 : 1;
 }
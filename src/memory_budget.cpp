@@ -0,0 +1,72 @@
+#include "memory_budget.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+memory_reservation::memory_reservation(memory_reservation&& other) noexcept
+    : owner(std::exchange(other.owner, nullptr)), held(std::exchange(other.held, 0)) {}
+
+memory_reservation& memory_reservation::operator=(memory_reservation&& other) noexcept {
+    if (this != &other) {
+        release();
+        owner = std::exchange(other.owner, nullptr);
+        held = std::exchange(other.held, 0);
+    }
+    return *this;
+}
+
+memory_reservation memory_reservation::split(std::size_t bytes) {
+    bytes = std::min(bytes, held);
+    held -= bytes;
+    return memory_reservation(owner, bytes);
+}
+
+void memory_reservation::release() {
+    if (owner && held > 0) {
+        owner->release(held);
+    }
+    held = 0;
+}
+
+memory_budget::memory_budget(std::size_t limit_bytes) {
+    counters.limit_bytes = limit_bytes;
+}
+
+memory_reservation memory_budget::reserve(std::size_t bytes, const cancellation_token& cancel) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto fits = [&] {
+        return counters.limit_bytes == 0 || counters.reserved_bytes == 0 || counters.reserved_bytes + bytes <= counters.limit_bytes;
+    };
+    if (!fits()) {
+        ++counters.waited;
+        auto start = std::chrono::steady_clock::now();
+        // Cancellation has no wake-up of its own, so the wait polls it
+        while (!room.wait_for(lock, std::chrono::milliseconds(10), fits)) {
+            if (cancel.is_cancelled()) {
+                counters.wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                throw operation_cancelled();
+            }
+        }
+        counters.wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (counters.limit_bytes > 0 && bytes > counters.limit_bytes) {
+        ++counters.oversized;
+    }
+    ++counters.admitted;
+    counters.reserved_bytes += bytes;
+    counters.peak_reserved_bytes = std::max(counters.peak_reserved_bytes, counters.reserved_bytes);
+    return memory_reservation(this, bytes);
+}
+
+memory_budget_stats memory_budget::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void memory_budget::release(std::size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.reserved_bytes -= bytes;
+    }
+    room.notify_all();
+}
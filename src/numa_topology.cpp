@@ -0,0 +1,102 @@
+#include "numa_topology.h"
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+/**
+ * @brief Parses a sysfs CPU list such as "0-3,8-11".
+ */
+std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::istringstream ranges(text);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        std::size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+} // namespace
+
+numa_topology::numa_topology() {
+    const std::filesystem::path root("/sys/devices/system/node");
+    std::vector<std::pair<int, std::vector<int>>> nodes;
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(root, error)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4 || !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+            continue;
+        }
+        std::ifstream list(entry.path() / "cpulist");
+        std::string text;
+        std::getline(list, text);
+        std::vector<int> cpus;
+        try {
+            cpus = parse_cpu_list(text);
+        } catch (const std::exception&) {
+            continue;
+        }
+        // Memory-only nodes have no CPUs to run workers on
+        if (!cpus.empty()) {
+            nodes.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+    for (auto& node : nodes) {
+        node_cpus.push_back(std::move(node.second));
+    }
+
+    if (node_cpus.empty()) {
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        node_cpus.emplace_back();
+        for (unsigned cpu = 0; cpu < count; ++cpu) {
+            node_cpus[0].push_back(static_cast<int>(cpu));
+        }
+    }
+    for (std::size_t node = 0; node < node_cpus.size(); ++node) {
+        for (int cpu : node_cpus[node]) {
+            if (static_cast<std::size_t>(cpu) >= cpu_node.size()) {
+                cpu_node.resize(cpu + 1, 0);
+            }
+            cpu_node[cpu] = node;
+        }
+    }
+}
+
+const numa_topology& numa_topology::system() {
+    static const numa_topology topology;
+    return topology;
+}
+
+bool numa_topology::pin_current_thread(std::size_t node) const {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : node_cpus[node]) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+std::size_t numa_topology::current_node() const {
+    int cpu = sched_getcpu();
+    return cpu >= 0 && static_cast<std::size_t>(cpu) < cpu_node.size() ? cpu_node[cpu] : 0;
+}
@@ -0,0 +1,51 @@
+#include "output_poison.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+using namespace cimg_library;
+
+namespace {
+
+std::atomic<bool>& poisoning() {
+    static std::atomic<bool> enabled([] {
+        const char* value = std::getenv("RESIZE_POISON_OUTPUTS");
+        return value && std::strcmp(value, "1") == 0;
+    }());
+    return enabled;
+}
+
+} // namespace
+
+void set_output_poisoning(bool enabled) {
+    poisoning().store(enabled, std::memory_order_relaxed);
+}
+
+bool output_poisoning() {
+    return poisoning().load(std::memory_order_relaxed);
+}
+
+void poison_output(const mutable_image_view& output) {
+    if (!output_poisoning() || output.empty()) {
+        return;
+    }
+    for (int c = 0; c < output.channels(); ++c) {
+        for (int y = 0; y < output.height(); ++y) {
+            unsigned char* row = output.row(y, c);
+            if (output.pixel_stride() == 1) {
+                std::fill(row, row + output.width(), output_poison_byte);
+            } else {
+                for (int x = 0; x < output.width(); ++x) {
+                    row[x * output.pixel_stride()] = output_poison_byte;
+                }
+            }
+        }
+    }
+}
+
+CImg<unsigned char> uninitialized_output(int width, int height, int channels) {
+    CImg<unsigned char> image(width, height, 1, channels);
+    poison_output(image);
+    return image;
+}
@@ -0,0 +1,49 @@
+#include "parallel_plan.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// A band has to amortize its scheduling cost at least this many times over
+const double min_band_overheads = 10.0;
+
+// Longest a band should run, so cancellation and interactive tasks are not held up
+const double max_band_seconds = 1e-3;
+
+} // namespace
+
+std::string parallel_plan::describe() const {
+    std::ostringstream text;
+    text << threads << (threads == 1 ? " thread, " : " threads, ") << bands << (bands == 1 ? " band" : " bands")
+         << " of " << band_rows << " rows, " << taps << " taps/sample, est " << std::fixed << std::setprecision(3)
+         << work_seconds * 1e3 << " ms, task overhead " << std::setprecision(1) << overhead_seconds * 1e6 << " us";
+    return text.str();
+}
+
+parallel_plan plan_parallel(std::size_t rows, double taps_per_row, std::size_t taps, double tap_seconds, const task_scheduler& scheduler) {
+    parallel_plan plan;
+    plan.taps = taps;
+    plan.band_rows = rows;
+    plan.overhead_seconds = scheduler.task_overhead_seconds();
+    plan.work_seconds = rows * taps_per_row * tap_seconds;
+    if (rows <= 1) {
+        return plan;
+    }
+
+    double min_band_seconds = min_band_overheads * plan.overhead_seconds;
+    double worthwhile = std::floor(plan.work_seconds / min_band_seconds);
+    if (worthwhile < 2.0) {
+        return plan;
+    }
+    std::size_t threads = std::min(scheduler.size(), static_cast<std::size_t>(worthwhile));
+    double bands = std::max<double>(threads * 4, std::ceil(plan.work_seconds / max_band_seconds));
+    bands = std::min({bands, worthwhile, static_cast<double>(rows)});
+
+    plan.band_rows = (rows + static_cast<std::size_t>(bands) - 1) / static_cast<std::size_t>(bands);
+    plan.bands = (rows + plan.band_rows - 1) / plan.band_rows;
+    plan.threads = std::min(threads, plan.bands);
+    return plan;
+}
@@ -0,0 +1,203 @@
+#include "pipe_server.h"
+#include "aligned_image.h"
+#include "batch_job.h"
+#include "output_poison.h"
+#include "resize_fanout.h"
+#include <cstdio>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cimg_library;
+
+namespace {
+
+/**
+ * @brief Parsed header line of one request.
+ */
+struct pipe_request {
+    std::string format;
+    std::size_t bytes = 0;
+    resize_job job;
+    std::string output_format;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
+bool read_line(std::FILE* in, std::string& line) {
+    line.clear();
+    int ch;
+    while ((ch = std::fgetc(in)) != EOF) {
+        if (ch == '\n') {
+            return true;
+        }
+        line.push_back(static_cast<char>(ch));
+    }
+    return !line.empty();
+}
+
+pipe_request parse_header(const std::string& line, const png_options& png_defaults) {
+    std::istringstream fields(line);
+    pipe_request request;
+    std::string bytes, size, option;
+    if (!(fields >> request.format >> bytes >> size >> request.job.method)) {
+        throw std::invalid_argument("expected '<format> <bytes> <size> <method> [option=value...]'");
+    }
+    // Digits only: a stream extraction would wrap a leading '-' around into a huge size_t
+    if (bytes.empty() || bytes.size() > 10 || bytes.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoull(bytes) > pipe_max_payload_bytes) {
+        throw std::invalid_argument("invalid payload size '" + bytes + "' (at most " + std::to_string(pipe_max_payload_bytes) + " bytes)");
+    }
+    request.bytes = static_cast<std::size_t>(std::stoull(bytes));
+    if (request.format != "png" && request.format != "raw") {
+        throw std::invalid_argument("unknown format '" + request.format + "'");
+    }
+    request.job.size = size_spec::parse(size);
+    request.job.png = png_defaults;
+    request.output_format = request.format;
+
+    while (fields >> option) {
+        if (option.compare(0, 4, "out=") == 0) {
+            request.output_format = option.substr(4);
+            if (request.output_format != "png" && request.output_format != "raw") {
+                throw std::invalid_argument("unknown output format '" + request.output_format + "'");
+            }
+        } else if (option.compare(0, 5, "dims=") == 0) {
+            char separator1 = 0, separator2 = 0;
+            std::istringstream dims(option.substr(5));
+            if (!(dims >> request.width >> separator1 >> request.height >> separator2 >> request.channels) ||
+                separator1 != 'x' || separator2 != 'x' || request.width <= 0 || request.height <= 0 ||
+                request.channels <= 0) {
+                throw std::invalid_argument("invalid option '" + option + "'");
+            }
+        } else {
+            apply_job_option(option, request.job);
+        }
+    }
+    if (request.format == "raw" && request.channels == 0) {
+        throw std::invalid_argument("raw input needs dims=WxHxC");
+    }
+    return request;
+}
+
+/**
+ * @brief Returns a view of the request's pixels: raw payloads are viewed in place, PNGs are
+ * decoded into the caller's image.
+ */
+image_view decode_payload(const pipe_request& request, std::vector<unsigned char>& payload, CImg<unsigned char>& decoded) {
+    if (request.format == "raw") {
+        std::size_t expected = static_cast<std::size_t>(request.width) * request.height * request.channels;
+        if (payload.size() != expected) {
+            throw std::invalid_argument("raw payload has " + std::to_string(payload.size()) + " bytes, dims need " + std::to_string(expected));
+        }
+        return image_view::interleaved(payload.data(), request.width, request.height, request.channels);
+    }
+
+    // Decode the PNG straight from memory through a FILE* view of the payload
+    std::FILE* memory = payload.empty() ? nullptr : fmemopen(payload.data(), payload.size(), "rb");
+    if (!memory) {
+        throw std::invalid_argument("empty PNG payload");
+    }
+    try {
+        decoded.load_png(memory);
+    } catch (...) {
+        std::fclose(memory);
+        throw;
+    }
+    std::fclose(memory);
+    return decoded;
+}
+
+/**
+ * @brief Resizes to the target and encodes the result into out; raw results are resized
+ * straight into the output buffer.
+ */
+void resize_and_encode(const image_view& image, const resize_target& target, const pipe_request& request, std::vector<unsigned char>& out) {
+    if (request.output_format == "png") {
+        aligned_image resized(target.width, target.height, image.channels());
+        resize_fanout_into(image, {target}, {resized});
+        encode_png(resized, request.job.png, out);
+        return;
+    }
+    out.resize(static_cast<std::size_t>(target.width) * target.height * image.channels());
+    mutable_image_view result = mutable_image_view::interleaved(out.data(), target.width, target.height, image.channels());
+    poison_output(result);
+    resize_fanout_into(image, {target}, {result});
+}
+
+void write_frame(std::FILE* out, const std::string& header, const std::vector<unsigned char>& payload) {
+    std::fwrite(header.data(), 1, header.size(), out);
+    std::fwrite(payload.data(), 1, payload.size(), out);
+    std::fflush(out);
+}
+
+void write_error(std::FILE* out, const std::string& message) {
+    write_frame(out, "error " + std::to_string(message.size()) + "\n", std::vector<unsigned char>(message.begin(), message.end()));
+}
+
+} // namespace
+
+pipe_server::pipe_server(const png_options& png_defaults, std::ostream* log)
+    : png_defaults(png_defaults), log(log) {}
+
+int pipe_server::serve(std::FILE* in, std::FILE* out) {
+    int status = 0;
+    std::string line;
+    std::vector<unsigned char> payload;
+    std::vector<unsigned char> encoded;
+    CImg<unsigned char> decoded;
+    std::size_t frame = 0;
+
+    while (read_line(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        ++frame;
+
+        pipe_request request;
+        try {
+            request = parse_header(line, png_defaults);
+        } catch (const std::exception& e) {
+            write_error(out, std::string("malformed header: ") + e.what());
+            return 2;
+        }
+        try {
+            payload.resize(request.bytes);
+        } catch (const std::bad_alloc&) {
+            write_error(out, "malformed header: cannot allocate a payload of " + std::to_string(request.bytes) + " bytes");
+            return 2;
+        }
+        if (std::fread(payload.data(), 1, payload.size(), in) != payload.size()) {
+            write_error(out, "truncated payload");
+            return 2;
+        }
+
+        try {
+            image_view image = decode_payload(request, payload, decoded);
+            resize_target target;
+            request.job.size.resolve(image.width(), image.height(), target.width, target.height);
+            target.method = request.job.method;
+            resize_and_encode(image, target, request, encoded);
+
+            std::ostringstream header;
+            header << request.output_format << ' ' << encoded.size() << ' ' << target.width << 'x'
+                   << target.height << 'x' << image.channels() << '\n';
+            write_frame(out, header.str(), encoded);
+            if (log) {
+                *log << "Frame " << frame << " resized using " << target.method << " to "
+                     << target.width << "x" << target.height << std::endl;
+            }
+        } catch (const std::exception& e) {
+            write_error(out, e.what());
+            status = 1;
+            if (log) {
+                *log << "Frame " << frame << " failed: " << e.what() << std::endl;
+            }
+        }
+    }
+    return status;
+}
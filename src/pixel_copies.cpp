@@ -0,0 +1,25 @@
+#include "pixel_copies.h"
+
+namespace {
+
+thread_local std::atomic<unsigned long long>* current_counter = nullptr;
+
+} // namespace
+
+pixel_copy_scope::pixel_copy_scope(std::atomic<unsigned long long>* counter) : previous(current_counter) {
+    current_counter = counter;
+}
+
+pixel_copy_scope::~pixel_copy_scope() {
+    current_counter = previous;
+}
+
+std::atomic<unsigned long long>* pixel_copy_scope::current() {
+    return current_counter;
+}
+
+void count_pixel_copy(std::size_t bytes) {
+    if (current_counter) {
+        current_counter->fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
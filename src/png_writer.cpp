@@ -0,0 +1,358 @@
+#include "png_writer.h"
+#include "pixel_copies.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <zlib.h>
+
+using namespace cimg_library;
+
+namespace {
+
+/**
+ * @brief Compressed output of one row band.
+ */
+struct png_band {
+    int first_row;
+    int end_row;
+    std::vector<unsigned char> deflated;
+    uLong adler = 0;
+    uLong length = 0;
+    std::string error;
+};
+
+void put_u32(std::vector<unsigned char>& out, std::uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+/**
+ * @brief Appends a chunk whose payload is the concatenation of prefix, data and suffix.
+ */
+void put_chunk(std::vector<unsigned char>& out, const char* type, const unsigned char* prefix, std::size_t prefix_size,
+               const unsigned char* data, std::size_t size, const unsigned char* suffix, std::size_t suffix_size) {
+    put_u32(out, static_cast<std::uint32_t>(prefix_size + size + suffix_size));
+    std::size_t type_offset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), prefix, prefix + prefix_size);
+    out.insert(out.end(), data, data + size);
+    out.insert(out.end(), suffix, suffix + suffix_size);
+    uLong crc = crc32(0L, out.data() + type_offset, static_cast<uInt>(out.size() - type_offset));
+    put_u32(out, static_cast<std::uint32_t>(crc));
+}
+
+void interleave_row(const image_view& image, int y, unsigned char* out) {
+    int channels = image.channels();
+    std::ptrdiff_t step = image.pixel_stride();
+    for (int c = 0; c < channels; ++c) {
+        const unsigned char* in = image.row(y, c);
+        for (int x = 0; x < image.width(); ++x) {
+            out[x * channels + c] = in[x * step];
+        }
+    }
+}
+
+unsigned char paeth_predictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return static_cast<unsigned char>(a);
+    }
+    return static_cast<unsigned char>(pb <= pc ? b : c);
+}
+
+/**
+ * @brief Writes the filter type byte followed by the filtered row.
+ */
+void filter_row(png_filter filter, const unsigned char* row, const unsigned char* prior, std::size_t bytes, int bpp, unsigned char* out) {
+    out[0] = static_cast<unsigned char>(filter);
+    unsigned char* filtered = out + 1;
+    for (std::size_t i = 0; i < bytes; ++i) {
+        int left = i >= static_cast<std::size_t>(bpp) ? row[i - bpp] : 0;
+        int up = prior[i];
+        int up_left = i >= static_cast<std::size_t>(bpp) ? prior[i - bpp] : 0;
+        int predicted = 0;
+        switch (filter) {
+        case png_filter::sub: predicted = left; break;
+        case png_filter::up: predicted = up; break;
+        case png_filter::average: predicted = (left + up) / 2; break;
+        case png_filter::paeth: predicted = paeth_predictor(left, up, up_left); break;
+        default: break;
+        }
+        filtered[i] = static_cast<unsigned char>(row[i] - predicted);
+    }
+}
+
+unsigned long filtered_cost(const unsigned char* filtered, std::size_t bytes) {
+    unsigned long cost = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+        cost += std::abs(static_cast<int>(static_cast<signed char>(filtered[i])));
+    }
+    return cost;
+}
+
+// The compressor state goes through operator new so allocation tracking charges it to the job
+voidpf zlib_allocate(voidpf, uInt items, uInt size) {
+    return ::operator new(static_cast<std::size_t>(items) * size, std::nothrow);
+}
+
+void zlib_free(voidpf, voidpf block) {
+    ::operator delete(block);
+}
+
+void deflate_band(const image_view& image, const png_options& options, bool last, png_band& band) {
+    int bpp = image.channels();
+    std::size_t row_bytes = static_cast<std::size_t>(image.width()) * bpp;
+    std::vector<unsigned char> prior(row_bytes, 0);
+    std::vector<unsigned char> row(row_bytes);
+    std::vector<unsigned char> filtered(row_bytes + 1);
+    std::vector<unsigned char> candidate(row_bytes + 1);
+
+    // The first row of a band is filtered against the last row of the previous band; only
+    // the compressor state starts fresh
+    if (band.first_row > 0) {
+        interleave_row(image, band.first_row - 1, prior.data());
+    }
+
+    z_stream stream = {};
+    stream.zalloc = zlib_allocate;
+    stream.zfree = zlib_free;
+    int strategy = options.filter == png_filter::none ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+    if (deflateInit2(&stream, std::clamp(options.level, 0, 9), Z_DEFLATED, -15, 8, strategy) != Z_OK) {
+        band.error = "deflateInit2 failed";
+        return;
+    }
+    uLong band_bytes = static_cast<uLong>((row_bytes + 1) * (band.end_row - band.first_row));
+    band.deflated.resize(deflateBound(&stream, band_bytes) + 64);
+    stream.next_out = band.deflated.data();
+    stream.avail_out = static_cast<uInt>(band.deflated.size());
+    band.adler = adler32(0L, Z_NULL, 0);
+
+    for (int y = band.first_row; y < band.end_row; ++y) {
+        interleave_row(image, y, row.data());
+        if (options.filter == png_filter::adaptive) {
+            unsigned long best_cost = ~0UL;
+            for (png_filter filter : {png_filter::none, png_filter::sub, png_filter::up, png_filter::average, png_filter::paeth}) {
+                filter_row(filter, row.data(), prior.data(), row_bytes, bpp, candidate.data());
+                unsigned long cost = filtered_cost(candidate.data() + 1, row_bytes);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    filtered.swap(candidate);
+                }
+            }
+        } else {
+            filter_row(options.filter, row.data(), prior.data(), row_bytes, bpp, filtered.data());
+        }
+        band.adler = adler32(band.adler, filtered.data(), static_cast<uInt>(filtered.size()));
+
+        stream.next_in = filtered.data();
+        stream.avail_in = static_cast<uInt>(filtered.size());
+        while (stream.avail_in > 0) {
+            if (stream.avail_out == 0) {
+                std::size_t used = band.deflated.size();
+                band.deflated.resize(used * 2);
+                stream.next_out = band.deflated.data() + used;
+                stream.avail_out = static_cast<uInt>(band.deflated.size() - used);
+            }
+            deflate(&stream, Z_NO_FLUSH);
+        }
+        prior.swap(row);
+    }
+
+    // A sync flush byte-aligns the band without marking the final block, so the next band's
+    // raw deflate stream can follow directly
+    int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    for (;;) {
+        if (stream.avail_out == 0) {
+            std::size_t used = band.deflated.size();
+            band.deflated.resize(used * 2);
+            stream.next_out = band.deflated.data() + used;
+            stream.avail_out = static_cast<uInt>(band.deflated.size() - used);
+        }
+        int status = deflate(&stream, flush);
+        if (status == Z_STREAM_END || (flush == Z_SYNC_FLUSH && status != Z_STREAM_ERROR && stream.avail_out > 0)) {
+            break;
+        }
+        if (status != Z_OK && status != Z_BUF_ERROR) {
+            band.error = "deflate failed";
+            break;
+        }
+    }
+    band.deflated.resize(band.deflated.size() - stream.avail_out);
+    band.length = band_bytes;
+    deflateEnd(&stream);
+}
+
+/**
+ * @brief Encodes a PNG, deflating the bands on scheduler, or on the calling thread if it is null.
+ */
+void encode_bands(const image_view& image, const png_options& options, task_scheduler* scheduler, std::vector<unsigned char>& out) {
+    static const unsigned char color_types[] = {0, 0, 4, 2, 6};
+    if (image.empty()) {
+        throw std::invalid_argument("cannot encode an empty image as PNG");
+    }
+    if (image.channels() > 4) {
+        throw std::invalid_argument("PNG supports at most four channels");
+    }
+
+    // Split the rows into bands of roughly 256 KiB of raw data each
+    std::size_t row_bytes = static_cast<std::size_t>(image.width()) * image.channels() + 1;
+    int band_rows = options.band_rows ? static_cast<int>(options.band_rows)
+                                      : static_cast<int>(std::max<std::size_t>(1, (256 * 1024) / row_bytes));
+    std::vector<png_band> bands;
+    for (int y = 0; y < image.height(); y += band_rows) {
+        png_band band;
+        band.first_row = y;
+        band.end_row = std::min(y + band_rows, image.height());
+        bands.push_back(std::move(band));
+    }
+
+    // options.threads caps the chunks the bands are dealt out in, and so the threads deflating
+    // at once; the scheduler's workers do the work, so an encoder thread adds no threads. The
+    // encoding thread's own time already covers the bands, so workers lend theirs.
+    auto deflate_range = [&](std::size_t begin, std::size_t end) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = begin; i < end; ++i) {
+            deflate_band(image, options, i + 1 == bands.size(), bands[i]);
+        }
+        if (scheduler) {
+            scheduler->note_lent(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+        }
+    };
+    if (!scheduler || options.threads == 1) {
+        deflate_range(0, bands.size());
+    } else {
+        std::size_t chunks = options.threads ? std::min<std::size_t>(options.threads, bands.size()) : bands.size();
+        scheduler->parallel_for(bands.size(), (bands.size() + chunks - 1) / chunks, deflate_range);
+    }
+
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (const png_band& band : bands) {
+        if (!band.error.empty()) {
+            throw std::runtime_error(band.error);
+        }
+        adler = adler32_combine(adler, band.adler, static_cast<z_off_t>(band.length));
+    }
+
+    static const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.assign(signature, signature + sizeof(signature));
+
+    std::vector<unsigned char> header;
+    put_u32(header, static_cast<std::uint32_t>(image.width()));
+    put_u32(header, static_cast<std::uint32_t>(image.height()));
+    header.push_back(8);
+    header.push_back(color_types[image.channels()]);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    put_chunk(out, "IHDR", nullptr, 0, header.data(), header.size(), nullptr, 0);
+
+    // zlib header (32 KiB window, level hint) in the first IDAT, Adler-32 trailer in the last
+    int level = std::clamp(options.level, 0, 9);
+    unsigned char level_hint = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    unsigned char zlib_header[2] = {0x78, static_cast<unsigned char>(level_hint << 6)};
+    zlib_header[1] += 31 - ((zlib_header[0] * 256 + zlib_header[1]) % 31);
+    std::vector<unsigned char> trailer;
+    put_u32(trailer, static_cast<std::uint32_t>(adler));
+
+    for (std::size_t i = 0; i < bands.size(); ++i) {
+        bool first = i == 0;
+        bool last = i + 1 == bands.size();
+        put_chunk(out, "IDAT", zlib_header, first ? sizeof(zlib_header) : 0,
+                  bands[i].deflated.data(), bands[i].deflated.size(), trailer.data(), last ? trailer.size() : 0);
+    }
+    put_chunk(out, "IEND", nullptr, 0, nullptr, 0, nullptr, 0);
+}
+
+// Without a scheduler, bands go to the shared one unless a single thread was asked for
+task_scheduler* default_scheduler(const png_options& options) {
+    return options.threads == 1 ? nullptr : &task_scheduler::shared();
+}
+
+void save_file(const std::vector<unsigned char>& encoded, const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+    // Closing flushes; a full disk or I/O error often only shows up there
+    file.close();
+    if (!file) {
+        throw std::runtime_error("cannot write '" + path + "'");
+    }
+}
+
+/**
+ * @brief Implements write_image; PNGs are encoded on scheduler, or as by the encode_png
+ * overload without one if it is null.
+ */
+void write_any(const image_view& image, const std::string& path, const png_options& options, task_scheduler* scheduler) {
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent);
+    }
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char ch) { return std::tolower(ch); });
+    if (extension == ".png") {
+        std::vector<unsigned char> encoded;
+        encode_bands(image, options, scheduler ? scheduler : default_scheduler(options), encoded);
+        save_file(encoded, path);
+    } else if (image.layout() == pixel_layout::planar && image.row_stride() == image.width() &&
+               image.channel_stride() == static_cast<std::ptrdiff_t>(image.width()) * image.height()) {
+        CImg<unsigned char>(const_cast<unsigned char*>(image.data()), image.width(), image.height(), 1, image.channels(), true).save(path.c_str());
+    } else {
+        CImg<unsigned char> copy(image.width(), image.height(), 1, image.channels());
+        count_pixel_copy(copy.size());
+        cimg_forXYC(copy, x, y, c) {
+            copy(x, y, 0, c) = image(x, y, c);
+        }
+        copy.save(path.c_str());
+    }
+}
+
+} // namespace
+
+png_filter parse_png_filter(const std::string& name) {
+    if (name == "none") return png_filter::none;
+    if (name == "sub") return png_filter::sub;
+    if (name == "up") return png_filter::up;
+    if (name == "average") return png_filter::average;
+    if (name == "paeth") return png_filter::paeth;
+    if (name == "adaptive") return png_filter::adaptive;
+    throw std::invalid_argument("unknown PNG filter '" + name + "'");
+}
+
+void encode_png(const image_view& image, const png_options& options, task_scheduler& scheduler, std::vector<unsigned char>& out) {
+    encode_bands(image, options, &scheduler, out);
+}
+
+void encode_png(const image_view& image, const png_options& options, std::vector<unsigned char>& out) {
+    encode_bands(image, options, default_scheduler(options), out);
+}
+
+void write_png(const image_view& image, const std::string& path, const png_options& options, task_scheduler& scheduler) {
+    std::vector<unsigned char> encoded;
+    encode_png(image, options, scheduler, encoded);
+    save_file(encoded, path);
+}
+
+void write_png(const image_view& image, const std::string& path, const png_options& options) {
+    std::vector<unsigned char> encoded;
+    encode_png(image, options, encoded);
+    save_file(encoded, path);
+}
+
+void write_image(const image_view& image, const std::string& path, const png_options& options, task_scheduler& scheduler) {
+    write_any(image, path, options, &scheduler);
+}
+
+void write_image(const image_view& image, const std::string& path, const png_options& options) {
+    write_any(image, path, options, nullptr);
+}
@@ -0,0 +1,352 @@
+#include "resize_fanout.h"
+#include "output_poison.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+using namespace cimg_library;
+
+namespace {
+
+enum class fanout_method { nearest, bilinear };
+
+// Fan-out bands are few and long (at most four per worker), so they poll for cancellation
+// every few source rows rather than only at their start
+const int cancel_check_rows = 16;
+
+/**
+ * @brief Horizontal pass shared by all targets with the same method and width.
+ *
+ * The coordinate math mirrors resize_nearest_neighbour and resize_bilinear exactly so the
+ * separable result matches the per-pixel kernels bit for bit.
+ */
+struct horizontal_group {
+    explicit horizontal_group(std::pmr::memory_resource* scratch) : x1(scratch), x2(scratch), x_frac(scratch), row_needed(scratch) {}
+
+    fanout_method method = fanout_method::nearest;
+    int width = 0;
+    std::size_t padded_width = 0;  ///< Row length in the caches, aligned_row_stride(width).
+    std::pmr::vector<int> x1;
+    std::pmr::vector<int> x2;
+    std::pmr::vector<float> x_frac;
+    std::pmr::vector<bool> row_needed;
+};
+
+/**
+ * @brief Two most recent resampled source rows of one group, indexed by source row parity.
+ *
+ * Each band owns its caches, so bands of the same image can run concurrently.
+ */
+struct row_cache {
+    explicit row_cache(std::pmr::memory_resource* scratch)
+        : nearest_rows{std::pmr::vector<unsigned char>(scratch), std::pmr::vector<unsigned char>(scratch)},
+          bilinear_rows{std::pmr::vector<float>(scratch), std::pmr::vector<float>(scratch)} {}
+
+    std::pmr::vector<unsigned char> nearest_rows[2];
+    std::pmr::vector<float> bilinear_rows[2];
+};
+
+/**
+ * @brief Vertical pass of one target, reading rows from its horizontal group.
+ */
+struct vertical_plan {
+    explicit vertical_plan(std::pmr::memory_resource* scratch) : y1(scratch), y2(scratch), y_frac(scratch) {}
+
+    std::size_t group = 0;
+    std::pmr::vector<int> y1;
+    std::pmr::vector<int> y2;
+    std::pmr::vector<float> y_frac;
+};
+
+fanout_method parse_method(const std::string& method) {
+    if (method == "nearest") {
+        return fanout_method::nearest;
+    }
+    if (method == "bilinear") {
+        return fanout_method::bilinear;
+    }
+    throw std::invalid_argument("unknown method '" + method + "'");
+}
+
+/**
+ * @brief Fills source coordinate tables for one axis.
+ */
+void build_axis(fanout_method method, int source_size, int new_size, std::pmr::vector<int>& first, std::pmr::vector<int>& second,
+                std::pmr::vector<float>& frac) {
+    float ratio = static_cast<float>(source_size) / new_size;
+    first.resize(new_size);
+    second.resize(new_size);
+    frac.assign(new_size, 0.0f);
+    for (int i = 0; i < new_size; ++i) {
+        float position = i * ratio;
+        if (method == fanout_method::nearest) {
+            int nearest = static_cast<int>(std::round(position));
+            first[i] = second[i] = std::max(0, std::min(nearest, source_size - 1));
+        } else {
+            first[i] = static_cast<int>(position);
+            second[i] = std::min(first[i] + 1, source_size - 1);
+            frac[i] = position - first[i];
+        }
+    }
+}
+
+/**
+ * @brief Returns the source samples a method reads per output sample.
+ */
+std::size_t method_taps(fanout_method method) {
+    return method == fanout_method::nearest ? 1 : 4;
+}
+
+float interpolate(float start, float end, float factor) {
+    return start + factor * (end - start);
+}
+
+void resample_row(const horizontal_group& group, row_cache& cache, const image_view& source, int source_row) {
+    int parity = source_row & 1;
+    std::ptrdiff_t step = source.pixel_stride();
+    for (int c = 0; c < source.channels(); ++c) {
+        const unsigned char* in = source.row(source_row, c);
+        if (group.method == fanout_method::nearest) {
+            unsigned char* out = cache.nearest_rows[parity].data() + static_cast<std::size_t>(c) * group.padded_width;
+            for (int x = 0; x < group.width; ++x) {
+                out[x] = in[group.x1[x] * step];
+            }
+        } else {
+            float* out = cache.bilinear_rows[parity].data() + static_cast<std::size_t>(c) * group.padded_width;
+            for (int x = 0; x < group.width; ++x) {
+                out[x] = interpolate(in[group.x1[x] * step], in[group.x2[x] * step], group.x_frac[x]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Blends one aligned block of image_row_alignment samples of two resampled rows.
+ *
+ * The fixed trip count and non-aliasing pointers let the loop vectorise without a remainder
+ * or a runtime overlap check. Samples lie in [0, 255], where converting through int
+ * truncates exactly like a direct float to unsigned char conversion, which does not vectorise.
+ */
+void interpolate_block(unsigned char* __restrict out, const float* __restrict top, const float* __restrict bottom, float factor) {
+    out = static_cast<unsigned char*>(__builtin_assume_aligned(out, image_row_alignment));
+    for (int x = 0; x < static_cast<int>(image_row_alignment); ++x) {
+        out[x] = static_cast<unsigned char>(static_cast<int>(interpolate(top[x], bottom[x], factor)));
+    }
+}
+
+void emit_row(const horizontal_group& group, const row_cache& cache, const vertical_plan& plan, const mutable_image_view& result, int y) {
+    std::ptrdiff_t step = result.pixel_stride();
+    // Outputs with aligned, padded rows are written a whole padded row at a time: the caches
+    // are padded to the same length, so fixed-size blocks cover the row tail included and
+    // compile to aligned vector stores without a scalar remainder
+    bool aligned = result.aligned_rows();
+    for (int c = 0; c < result.channels(); ++c) {
+        std::size_t offset = static_cast<std::size_t>(c) * group.padded_width;
+        unsigned char* out = result.row(y, c);
+        if (group.method == fanout_method::nearest) {
+            const unsigned char* row = cache.nearest_rows[plan.y1[y] & 1].data() + offset;
+            if (aligned) {
+                std::copy(row, row + group.padded_width, out);
+            } else if (step == 1) {
+                std::copy(row, row + group.width, out);
+            } else {
+                for (int x = 0; x < group.width; ++x) {
+                    out[x * step] = row[x];
+                }
+            }
+        } else {
+            const float* top = cache.bilinear_rows[plan.y1[y] & 1].data() + offset;
+            const float* bottom = cache.bilinear_rows[plan.y2[y] & 1].data() + offset;
+            float factor = plan.y_frac[y];
+            if (aligned) {
+                for (std::size_t block = 0; block < group.padded_width; block += image_row_alignment) {
+                    interpolate_block(out + block, top + block, bottom + block, factor);
+                }
+            } else if (step == 1) {
+                for (int x = 0; x < group.width; ++x) {
+                    out[x] = static_cast<unsigned char>(interpolate(top[x], bottom[x], factor));
+                }
+            } else {
+                for (int x = 0; x < group.width; ++x) {
+                    out[x * step] = static_cast<unsigned char>(interpolate(top[x], bottom[x], factor));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sweeps the source rows [first_row, end_row) and emits every output row whose last
+ * source row falls in that range.
+ *
+ * The row before the band is resampled first when needed, since the first emitted bilinear
+ * rows may read it.
+ */
+void sweep_band(const image_view& source, const std::vector<horizontal_group>& groups,
+                const std::vector<vertical_plan>& plans, const std::vector<mutable_image_view>& results,
+                int first_row, int end_row, const cancellation_token& cancel, std::pmr::memory_resource* scratch) {
+    std::vector<row_cache> caches;
+    caches.reserve(groups.size());
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        caches.emplace_back(scratch);
+        // Padded and zero-filled, so the padding converts to valid samples when written out
+        std::size_t row_size = groups[g].padded_width * source.channels();
+        for (int parity = 0; parity < 2; ++parity) {
+            if (groups[g].method == fanout_method::nearest) {
+                caches[g].nearest_rows[parity].resize(row_size);
+            } else {
+                caches[g].bilinear_rows[parity].resize(row_size);
+            }
+        }
+    }
+
+    std::pmr::vector<int> next_row(plans.size(), 0, scratch);
+    for (std::size_t t = 0; t < plans.size(); ++t) {
+        next_row[t] = static_cast<int>(std::lower_bound(plans[t].y2.begin(), plans[t].y2.end(), first_row) - plans[t].y2.begin());
+    }
+
+    for (int source_row = std::max(0, first_row - 1); source_row < end_row; ++source_row) {
+        if ((source_row - first_row) % cancel_check_rows == 0) {
+            cancel.throw_if_cancelled();
+        }
+        for (std::size_t g = 0; g < groups.size(); ++g) {
+            if (groups[g].row_needed[source_row]) {
+                resample_row(groups[g], caches[g], source, source_row);
+            }
+        }
+        if (source_row < first_row) {
+            continue;
+        }
+        for (std::size_t t = 0; t < plans.size(); ++t) {
+            const vertical_plan& plan = plans[t];
+            int height = static_cast<int>(plan.y2.size());
+            while (next_row[t] < height && plan.y2[next_row[t]] <= source_row) {
+                emit_row(groups[plan.group], caches[plan.group], plan, results[t], next_row[t]);
+                ++next_row[t];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Coordinate tables of one fan-out.
+ */
+struct fanout_setup {
+    std::vector<horizontal_group> groups;
+    std::vector<vertical_plan> plans;
+    double taps = 0.0;
+};
+
+/**
+ * @brief Builds one horizontal group per distinct (method, width) and one vertical plan per
+ * target, and counts the taps of the whole fan-out.
+ */
+fanout_setup prepare(const image_view& source, const std::vector<resize_target>& targets, std::pmr::memory_resource* scratch) {
+    fanout_setup setup;
+    std::map<std::pair<fanout_method, int>, std::size_t> group_index;
+    setup.plans.reserve(targets.size());
+
+    for (std::size_t t = 0; t < targets.size(); ++t) {
+        const resize_target& target = targets[t];
+        if (target.width <= 0 || target.height <= 0) {
+            throw std::invalid_argument("target size must be positive");
+        }
+        fanout_method method = parse_method(target.method);
+
+        auto inserted = group_index.emplace(std::make_pair(method, target.width), setup.groups.size());
+        if (inserted.second) {
+            horizontal_group group(scratch);
+            group.method = method;
+            group.width = target.width;
+            group.padded_width = aligned_row_stride(target.width);
+            build_axis(method, source.width(), target.width, group.x1, group.x2, group.x_frac);
+            group.row_needed.assign(source.height(), false);
+            setup.groups.push_back(std::move(group));
+        }
+
+        vertical_plan& plan = setup.plans.emplace_back(scratch);
+        plan.group = inserted.first->second;
+        build_axis(method, source.height(), target.height, plan.y1, plan.y2, plan.y_frac);
+        for (int y = 0; y < target.height; ++y) {
+            setup.groups[plan.group].row_needed[plan.y1[y]] = true;
+            setup.groups[plan.group].row_needed[plan.y2[y]] = true;
+        }
+
+        setup.taps += static_cast<double>(target.width) * target.height * source.channels() * method_taps(method);
+    }
+    return setup;
+}
+
+/**
+ * @brief Returns the time of one tap of the fan-out sweep, measured once per process.
+ */
+double tap_seconds() {
+    static const double seconds = [] {
+        CImg<unsigned char> source(96, 96, 1, 3, 0);
+        std::vector<resize_target> targets{resize_target{64, 64, "bilinear"}};
+        fanout_setup setup = prepare(source, targets, std::pmr::get_default_resource());
+        CImg<unsigned char> result(64, 64, 1, source.spectrum());
+        std::vector<mutable_image_view> results{result};
+        double best = 0.0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            sweep_band(source, setup.groups, setup.plans, results, 0, source.height(), cancellation_token(),
+                       std::pmr::get_default_resource());
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = run == 0 ? elapsed : std::min(best, elapsed);
+        }
+        return std::max(best / setup.taps, 1e-12);
+    }();
+    return seconds;
+}
+
+} // namespace
+
+parallel_plan plan_fanout(const image_view& source, const std::vector<resize_target>& targets, const task_scheduler& scheduler) {
+    double taps = 0.0;
+    std::size_t max_taps = 1;
+    for (const resize_target& target : targets) {
+        std::size_t per_sample = method_taps(parse_method(target.method));
+        taps += static_cast<double>(target.width) * target.height * source.channels() * per_sample;
+        max_taps = std::max(max_taps, per_sample);
+    }
+    return plan_parallel(source.height(), taps / std::max(1, source.height()), max_taps, tap_seconds(), scheduler);
+}
+
+void resize_fanout_into(const image_view& source, const std::vector<resize_target>& targets, const std::vector<mutable_image_view>& outputs,
+                        task_scheduler& scheduler, const cancellation_token& cancel, std::pmr::memory_resource* scratch) {
+    fanout_setup setup = prepare(source, targets, scratch);
+    if (outputs.size() != targets.size()) {
+        throw std::invalid_argument("one output image is needed per target");
+    }
+    for (std::size_t t = 0; t < targets.size(); ++t) {
+        if (outputs[t].width() != targets[t].width || outputs[t].height() != targets[t].height ||
+            outputs[t].channels() != source.channels()) {
+            throw std::invalid_argument("output image does not match its target size");
+        }
+    }
+
+    // One sweep over the source rows, split into bands of source rows as planned
+    parallel_plan split = plan_fanout(source, targets, scheduler);
+    scheduler.parallel_for(source.height(), split.band_rows, [&](std::size_t begin, std::size_t end) {
+        sweep_band(source, setup.groups, setup.plans, outputs, static_cast<int>(begin), static_cast<int>(end), cancel, scratch);
+    });
+}
+
+std::vector<CImg<unsigned char>> resize_fanout(const image_view& source, const std::vector<resize_target>& targets, task_scheduler& scheduler,
+                                               const cancellation_token& cancel, std::pmr::memory_resource* scratch) {
+    std::vector<CImg<unsigned char>> results;
+    std::vector<mutable_image_view> outputs;
+    results.reserve(targets.size());
+    for (const resize_target& target : targets) {
+        // Sizes are validated by resize_fanout_into(); skip the allocation of invalid ones
+        bool valid = target.width > 0 && target.height > 0;
+        results.push_back(valid ? uninitialized_output(target.width, target.height, source.channels()) : CImg<unsigned char>());
+        outputs.emplace_back(results.back());
+    }
+    resize_fanout_into(source, targets, outputs, scheduler, cancel, scratch);
+    return results;
+}
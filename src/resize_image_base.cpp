@@ -0,0 +1,236 @@
+#include "resize_image_base.h"
+#include "output_poison.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <typeindex>
+#include <unistd.h>
+#include <vector>
+
+using namespace cimg_library;
+
+namespace {
+
+/**
+ * @brief Returns the L2 size of the first core, or 1 MiB when the system does not report it.
+ */
+std::size_t l2_cache_bytes() {
+    static const std::size_t bytes = [] {
+        long reported = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        return reported > 0 ? static_cast<std::size_t>(reported) : std::size_t(1) << 20;
+    }();
+    return bytes;
+}
+
+} // namespace
+
+void resize_image_base::resize_region(const image_view& window, int window_x, int window_y,
+                                      const mutable_image_view& result, int result_x, int result_y,
+                                      const resize_geometry& geometry, const image_rect& output) const {
+    float x_ratio = static_cast<float>(geometry.source_width) / geometry.new_width;
+    float y_ratio = static_cast<float>(geometry.source_height) / geometry.new_height;
+
+    for (int y = output.y; y < output.y + output.height; ++y) {
+        for (int x = output.x; x < output.x + output.width; ++x) {
+            for (int c = 0; c < window.channels(); ++c) {
+                // Subtracting the integer window origin is exact, so a window samples the same
+                // source positions as the full image would
+                float src_x = x * x_ratio - window_x;
+                float src_y = y * y_ratio - window_y;
+                result(x - result_x, y - result_y, c) = estimate_color(window, src_x, src_y, c);
+            }
+        }
+    }
+}
+
+double resize_image_base::tap_seconds() const {
+    // Resizers are created per job, so the measurement is kept per class rather than per object
+    static std::mutex measured_mutex;
+    static std::map<std::type_index, double> measured;
+    {
+        std::lock_guard<std::mutex> lock(measured_mutex);
+        auto found = measured.find(typeid(*this));
+        if (found != measured.end()) {
+            return found->second;
+        }
+    }
+
+    // Time a small serial resize; threads racing here both measure, which is harmless
+    resize_geometry geometry{96, 96, 64, 64};
+    CImg<unsigned char> window(geometry.source_width, geometry.source_height, 1, 3, 0);
+    CImg<unsigned char> result(geometry.new_width, geometry.new_height, 1, 3);
+    image_rect whole{0, 0, geometry.new_width, geometry.new_height};
+    double best = 0.0;
+    for (int run = 0; run < 3; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        resize_region(window, 0, 0, result, 0, 0, geometry, whole);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = run == 0 ? elapsed : std::min(best, elapsed);
+    }
+    double taps = static_cast<double>(whole.width) * whole.height * result.spectrum() * taps_per_sample(geometry);
+    double seconds = std::max(best / taps, 1e-12);
+    std::lock_guard<std::mutex> lock(measured_mutex);
+    measured[typeid(*this)] = seconds;
+    return seconds;
+}
+
+std::size_t resize_image_base::taps_per_sample(const resize_geometry& geometry) const {
+    // Taps of the middle output pixel; the kernels read the same number everywhere but the edges
+    int x_begin, x_end, y_begin, y_end;
+    sample_span(geometry.new_width / 2, geometry.new_width / 2, geometry.source_width, geometry.new_width, x_begin, x_end);
+    sample_span(geometry.new_height / 2, geometry.new_height / 2, geometry.source_height, geometry.new_height, y_begin, y_end);
+    return static_cast<std::size_t>(std::max(1, x_end - x_begin)) * std::max(1, y_end - y_begin);
+}
+
+parallel_plan resize_image_base::plan(const resize_geometry& geometry, int channels, const task_scheduler& scheduler) const {
+    std::size_t taps = taps_per_sample(geometry);
+    double taps_per_row = static_cast<double>(geometry.new_width) * channels * taps;
+    return plan_parallel(geometry.new_height, taps_per_row, taps, tap_seconds(), scheduler);
+}
+
+void resize_image_base::resize_parallel(const image_view& source, const mutable_image_view& result,
+                                        task_scheduler& scheduler, parallel_mode mode, const cancellation_token& cancel) const {
+    resize_geometry geometry{source.width(), source.height(), result.width(), result.height()};
+    parallel_plan split = plan(geometry, result.channels(), scheduler);
+
+    // Outputs too small to be worth splitting run on the calling thread in either mode
+    if (mode == parallel_mode::row_bands || split.bands == 1) {
+        scheduler.parallel_for(result.height(), split.band_rows, [&](std::size_t begin, std::size_t end) {
+            cancel.throw_if_cancelled();
+            image_rect band{0, static_cast<int>(begin), result.width(), static_cast<int>(end - begin)};
+            resize_region(source, 0, 0, result, 0, 0, geometry, band);
+        });
+        return;
+    }
+
+    // Square tiles whose output plus source footprint fill half of L2, in multiples of 16;
+    // narrow outputs get full-width tiles that are correspondingly taller. A tile reads only
+    // its footprint rows and columns of the source, so they stay cached while it is filled.
+    std::size_t budget = l2_cache_bytes() / 2;
+    float x_ratio = static_cast<float>(geometry.source_width) / geometry.new_width;
+    float y_ratio = static_cast<float>(geometry.source_height) / geometry.new_height;
+    double bytes_per_output_pixel = result.channels() * (1.0 + std::max(1.0f, x_ratio) * std::max(1.0f, y_ratio));
+    int side = static_cast<int>(std::sqrt(budget / bytes_per_output_pixel)) / 16 * 16;
+    int tile_width = std::min(std::max(side, 16), result.width());
+    int tile_height = std::min(std::max(static_cast<int>(budget / bytes_per_output_pixel / tile_width), 1), result.height());
+    int tiles_across = (result.width() + tile_width - 1) / tile_width;
+    int tiles_down = (result.height() + tile_height - 1) / tile_height;
+
+    scheduler.parallel_for(static_cast<std::size_t>(tiles_across) * tiles_down, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index < end; ++index) {
+            cancel.throw_if_cancelled();
+            int tile_x = static_cast<int>(index % tiles_across) * tile_width;
+            int tile_y = static_cast<int>(index / tiles_across) * tile_height;
+            image_rect tile{tile_x, tile_y, std::min(tile_width, result.width() - tile_x), std::min(tile_height, result.height() - tile_y)};
+            resize_region(source, 0, 0, result, 0, 0, geometry, tile);
+        }
+    });
+}
+
+async_result<CImg<unsigned char>> resize_image_base::resize_async(CImg<unsigned char>&& source, int new_width, int new_height,
+                                                                  task_scheduler& scheduler, const cancellation_token& cancel) const {
+    async_promise<CImg<unsigned char>> promise;
+    async_result<CImg<unsigned char>> result = promise.result();
+    // std::function needs a copyable task, so the image travels behind a shared pointer
+    auto image = std::make_shared<CImg<unsigned char>>(std::move(source));
+    scheduler.submit([this, promise, image, new_width, new_height, &scheduler, cancel]() mutable {
+        try {
+            if (new_width <= 0 || new_height <= 0) {
+                throw std::invalid_argument("resize_async: target size must be positive");
+            }
+            // A job cancelled while queued never allocates its output
+            cancel.throw_if_cancelled();
+            CImg<unsigned char> output = uninitialized_output(new_width, new_height, image->spectrum());
+            resize_parallel(*image, output, scheduler, parallel_mode::row_bands, cancel);
+            image.reset();
+            promise.set_value(std::move(output));
+        } catch (...) {
+            // Drop the source before completing, so a cancelled job holds no pixels
+            image.reset();
+            promise.set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
+
+async_result<CImg<unsigned char>> resize_image_base::resize_async(CImg<unsigned char>&& source, int new_width, int new_height) const {
+    return resize_async(std::move(source), new_width, new_height, task_scheduler::shared());
+}
+
+CImg<unsigned char> resize_image_base::resize_inplace(CImg<unsigned char>&& image, int new_width, int new_height,
+                                                      task_scheduler& scheduler, const cancellation_token& cancel) const {
+    if (new_width <= 0 || new_height <= 0) {
+        throw std::invalid_argument("resize_inplace: target size must be positive");
+    }
+    if (new_width > image.width() || new_height > image.height() || image.depth() != 1) {
+        throw std::invalid_argument("resize_inplace: only a downscale of a single-slice image fits in its source");
+    }
+    CImg<unsigned char> result(std::move(image));
+    const resize_geometry geometry{result.width(), result.height(), new_width, new_height};
+    const std::size_t source_plane = static_cast<std::size_t>(result.width()) * result.height();
+    unsigned char* pixels = result.data();
+
+    // First sample of the source still needed once output row y of channel c is next
+    auto next_read = [&](int c, int y) {
+        if (y == new_height) {
+            if (++c == result.spectrum()) {
+                return std::numeric_limits<std::size_t>::max();
+            }
+            y = 0;
+        }
+        image_rect footprint = source_footprint(geometry, image_rect{0, y, new_width, 1});
+        return c * source_plane + static_cast<std::size_t>(footprint.y) * result.width();
+    };
+
+    // Outputs are produced in storage order (channel, row, column), and a downscaled sample
+    // never lands after the source it is read from. Finished samples wait here until the
+    // source beneath their final place has been read for the last time.
+    std::vector<unsigned char> pending;
+    std::size_t written = 0;
+    auto flush = [&](std::size_t limit) {
+        std::size_t count = limit > written ? std::min(pending.size(), limit - written) : 0;
+        std::copy_n(pending.begin(), count, pixels + written);
+        pending.erase(pending.begin(), pending.begin() + count);
+        written += count;
+    };
+
+    // Bands of about 1 MiB give the scheduler enough rows without a large pending buffer
+    const int band_rows = std::clamp((1 << 20) / new_width, 1, new_height);
+    for (int c = 0; c < result.spectrum(); ++c) {
+        image_view plane = image_view::planar(pixels + c * source_plane, result.width(), result.height(), 1);
+        for (int y = 0; y < new_height; y += band_rows) {
+            cancel.throw_if_cancelled();
+            int rows = std::min(band_rows, new_height - y);
+            std::size_t first = pending.size();
+            pending.resize(first + static_cast<std::size_t>(new_width) * rows);
+            mutable_image_view band = mutable_image_view::planar(pending.data() + first, new_width, rows, 1);
+            scheduler.parallel_for(rows, 1, [&](std::size_t begin, std::size_t end) {
+                image_rect span{0, y + static_cast<int>(begin), new_width, static_cast<int>(end - begin)};
+                resize_region(plane, 0, 0, band, 0, y, geometry, span);
+            });
+            flush(next_read(c, y + rows));
+        }
+    }
+    flush(std::numeric_limits<std::size_t>::max());
+
+    result._width = new_width;
+    result._height = new_height;
+    return result;
+}
+
+CImg<unsigned char> resize_image_base::resize_inplace(CImg<unsigned char>&& image, int new_width, int new_height) const {
+    return resize_inplace(std::move(image), new_width, new_height, task_scheduler::shared());
+}
+
+image_rect resize_image_base::source_footprint(const resize_geometry& geometry, const image_rect& output) const {
+    int x_begin, x_end, y_begin, y_end;
+    sample_span(output.x, output.x + output.width - 1, geometry.source_width, geometry.new_width, x_begin, x_end);
+    sample_span(output.y, output.y + output.height - 1, geometry.source_height, geometry.new_height, y_begin, y_end);
+    return image_rect{x_begin, y_begin, x_end - x_begin, y_end - y_begin};
+}
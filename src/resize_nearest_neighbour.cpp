@@ -1,33 +1,30 @@
 #include "resize_nearest_neighbour.h"
+#include "output_poison.h"
+#include "task_scheduler.h"
 #include <algorithm>
 #include <cmath>
-#include <iostream>
 
 using namespace cimg_library;
 
-cimg_library::CImg<unsigned char> resize_nearest_neighbour::resize(const cimg_library::CImg<unsigned char>& source, int new_width, int new_height) const {
-    cimg_library::CImg<unsigned char> result(new_width, new_height, 1, source.spectrum(), 0);
-    float x_ratio = static_cast<float>(source.width()) / new_width;
-    float y_ratio = static_cast<float>(source.height()) / new_height;
-
-    for (int y = 0; y < new_height; ++y) {
-        for (int x = 0; x < new_width; ++x) {
-            for (int c = 0; c < source.spectrum(); ++c) {
-                float src_x = x * x_ratio;
-                float src_y = y * y_ratio;
-                result(x, y, 0, c) = estimate_color(source, src_x, src_y, c);
-            }
-        }
-    }
+cimg_library::CImg<unsigned char> resize_nearest_neighbour::resize(const image_view& source, int new_width, int new_height) const {
+    // Not zero-filled: the bands write every pixel, and leaving the pages untouched until then
+    // places them on the NUMA node of the worker that fills them
+    cimg_library::CImg<unsigned char> result = uninitialized_output(new_width, new_height, source.channels());
+    resize_parallel(source, result, task_scheduler::shared());
 
     return result;
 }
 
-unsigned char resize_nearest_neighbour::estimate_color(const cimg_library::CImg<unsigned char>& source, float x, float y, int channel) const {
+unsigned char resize_nearest_neighbour::estimate_color(const image_view& source, float x, float y, int channel) const {
     int nearest_x = static_cast<int>(round(x));
     int nearest_y = static_cast<int>(round(y));
     nearest_x = std::max(0, std::min(nearest_x, source.width() - 1));
     nearest_y = std::max(0, std::min(nearest_y, source.height() - 1));
-    std::cout << "Nearest neighbour estimate color at (" << nearest_x << ", " << nearest_y << ") in channel " << channel << std::endl;
-    return source(nearest_x, nearest_y, 0, channel);
+    return source(nearest_x, nearest_y, channel);
+}
+
+void resize_nearest_neighbour::sample_span(int first, int last, int source_size, int new_size, int& begin, int& end) const {
+    float ratio = static_cast<float>(source_size) / new_size;
+    begin = std::max(0, std::min(static_cast<int>(round(first * ratio)), source_size - 1));
+    end = std::max(0, std::min(static_cast<int>(round(last * ratio)), source_size - 1)) + 1;
 }
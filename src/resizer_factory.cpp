@@ -0,0 +1,18 @@
+#include "resizer_factory.h"
+#include "resize_bilinear.h"
+#include "resize_nearest_neighbour.h"
+
+std::unique_ptr<resize_image_base> create_resizer(const std::string& method) {
+    if (method == "nearest") {
+        return std::make_unique<resize_nearest_neighbour>();
+    }
+    if (method == "bilinear") {
+        return std::make_unique<resize_bilinear>();
+    }
+    return nullptr;
+}
+
+const std::vector<std::string>& resizer_methods() {
+    static const std::vector<std::string> methods = {"nearest", "bilinear"};
+    return methods;
+}
@@ -0,0 +1,363 @@
+#include "task_scheduler.h"
+#include "allocation_tracking.h"
+#include "numa_topology.h"
+#include "pixel_copies.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+namespace {
+
+const std::size_t no_worker = static_cast<std::size_t>(-1);
+
+// Identifies the scheduler and deque of the worker running on this thread
+thread_local const task_scheduler* tls_scheduler = nullptr;
+thread_local std::size_t tls_worker = no_worker;
+
+// Class of the task running on this thread, inherited by the tasks it submits
+thread_local task_priority tls_priority = task_priority::interactive;
+
+std::size_t priority_index(task_priority priority) {
+    return static_cast<std::size_t>(priority);
+}
+
+} // namespace
+
+task_scheduler::task_scheduler(std::size_t thread_count, bool pin_to_nodes)
+    : pinned(pin_to_nodes) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::size_t nodes = pinned ? std::min(numa_topology::system().node_count(), thread_count) : 1;
+    node_workers.resize(nodes);
+    bound_queued = std::vector<std::atomic<std::size_t>>(nodes);
+    for (std::size_t i = 0; i < thread_count; ++i) {
+        queues.push_back(std::make_unique<worker_queue>());
+        worker_node.push_back(i * nodes / thread_count);
+        node_workers[worker_node.back()].push_back(i);
+    }
+    workers.reserve(thread_count);
+    for (std::size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+    measure_overhead();
+}
+
+void task_scheduler::measure_overhead() {
+    // Round trips of an empty task through an idle worker: queueing, waking the worker and
+    // handing the result back. Nothing else can be queued yet, so only these are timed.
+    const int rounds = 15;
+    std::vector<double> samples;
+    for (int round = 0; round < rounds; ++round) {
+        std::atomic<bool> done(false);
+        auto start = std::chrono::steady_clock::now();
+        push(round % queues.size(), [&done] { done = true; }, task_priority::interactive);
+        while (!done) {
+            std::this_thread::yield();
+        }
+        samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::nth_element(samples.begin(), samples.begin() + rounds / 2, samples.end());
+    // Guard against a clock too coarse to see the round trip at all
+    overhead_seconds = std::max(samples[rounds / 2], 1e-7);
+    wait_idle();
+}
+
+task_scheduler::~task_scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+task_scheduler& task_scheduler::shared() {
+    static task_scheduler scheduler;
+    return scheduler;
+}
+
+std::size_t task_scheduler::current_worker() const {
+    return tls_scheduler == this ? tls_worker : no_worker;
+}
+
+std::size_t task_scheduler::current_node() const {
+    std::size_t worker = current_worker();
+    if (worker != no_worker) {
+        return worker_node[worker];
+    }
+    return pinned ? std::min(numa_topology::system().current_node(), node_count() - 1) : 0;
+}
+
+task_priority task_scheduler::current_priority() {
+    return tls_priority;
+}
+
+void task_scheduler::set_bulk_share(double share) {
+    share = std::min(1.0, std::max(0.0, share));
+    bulk_reserved = static_cast<std::size_t>(share * workers.size());
+}
+
+void task_scheduler::note_lent(std::chrono::nanoseconds time) {
+    if (current_worker() != no_worker) {
+        lent_nanoseconds += time.count();
+    }
+}
+
+void task_scheduler::submit(std::function<void()> task) {
+    submit(std::move(task), tls_priority);
+}
+
+void task_scheduler::submit(std::function<void()> task, task_priority priority) {
+    std::size_t home = current_worker();
+    if (home == no_worker) {
+        home = next_queue++ % queues.size();
+    }
+    push(home, std::move(task), priority);
+}
+
+void task_scheduler::submit(std::function<void()> task, std::size_t node) {
+    submit(std::move(task), node, tls_priority);
+}
+
+void task_scheduler::submit(std::function<void()> task, std::size_t node, task_priority priority) {
+    node %= node_count();
+    std::size_t home = current_worker();
+    if (home == no_worker || worker_node[home] != node) {
+        const std::vector<std::size_t>& candidates = node_workers[node];
+        home = candidates[next_queue++ % candidates.size()];
+    }
+    push(home, std::move(task), priority, true);
+}
+
+void task_scheduler::push(std::size_t home, std::function<void()> task, task_priority priority, bool node_bound) {
+    ++pending;
+    {
+        std::lock_guard<std::mutex> lock(queues[home]->mutex);
+        queues[home]->tasks[priority_index(priority)].push_back(queued_task{std::move(task), allocation_scope::current(), pixel_copy_scope::current(), node_bound});
+    }
+    ++queued_by_priority[priority_index(priority)];
+    if (node_bound) {
+        ++bound_queued[worker_node[home]];
+        ++bound_total;
+    }
+    ++queued;
+    {
+        // Taking the sleep lock orders this wake-up after a worker's check of `queued`
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    // The one worker woken may be on another node than a bound task's
+    if (node_bound && node_count() > 1) {
+        work_available.notify_all();
+    } else {
+        work_available.notify_one();
+    }
+}
+
+bool task_scheduler::has_work_for(std::size_t worker) const {
+    // Whether some queued task is not bound to another node. The counters are raised node
+    // first and lowered total first, so a racing update can only cause a spurious wake-up.
+    return queued + bound_queued[worker_node[worker]] > bound_total;
+}
+
+bool task_scheduler::take(std::size_t home, task_priority priority, queued_task& task) {
+    std::size_t level = priority_index(priority);
+    if (queued_by_priority[level] == 0) {
+        return false;
+    }
+    std::size_t count = queues.size();
+
+    // Newest task from our own deque first, then the oldest task of another deque
+    if (home != no_worker) {
+        std::lock_guard<std::mutex> lock(queues[home]->mutex);
+        std::deque<queued_task>& own = queues[home]->tasks[level];
+        if (!own.empty()) {
+            task = std::move(own.back());
+            own.pop_back();
+            if (task.node_bound) {
+                --bound_total;
+                --bound_queued[worker_node[home]];
+            }
+        }
+    }
+    // Steal within our own node first so its buffers stay local, then from the other nodes.
+    // Node-bound tasks are only stolen within their node; a thread outside the pool has none.
+    std::size_t start = home == no_worker ? 0 : home + 1;
+    for (int pass = 0; pass < 2 && !task.run; ++pass) {
+        for (std::size_t i = 0; i < count && !task.run; ++i) {
+            std::size_t victim_index = (start + i) % count;
+            bool same_node = home == no_worker || worker_node[victim_index] == worker_node[home];
+            if (same_node != (pass == 0)) {
+                continue;
+            }
+            bool take_bound = home != no_worker && same_node;
+            worker_queue& victim = *queues[victim_index];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            std::deque<queued_task>& tasks = victim.tasks[level];
+            auto oldest = take_bound ? tasks.begin()
+                                     : std::find_if(tasks.begin(), tasks.end(), [](const queued_task& queued) { return !queued.node_bound; });
+            if (oldest != tasks.end()) {
+                task = std::move(*oldest);
+                tasks.erase(oldest);
+                if (task.node_bound) {
+                    --bound_total;
+                    --bound_queued[worker_node[victim_index]];
+                }
+            }
+        }
+    }
+    if (!task.run) {
+        return false;
+    }
+    --queued_by_priority[level];
+    return true;
+}
+
+bool task_scheduler::run_one(std::size_t home, bool interactive_only) {
+    // Interactive work first, unless fewer threads than the bulk share are running bulk tasks
+    task_priority first = task_priority::interactive;
+    task_priority second = task_priority::bulk;
+    if (bulk_running < bulk_reserved) {
+        std::swap(first, second);
+    }
+    queued_task task;
+    task_priority priority = first;
+    if (interactive_only) {
+        // A bulk thread only gives way while the bulk share stays covered without it
+        priority = task_priority::interactive;
+        if (bulk_running <= bulk_reserved || !take(home, priority, task)) {
+            return false;
+        }
+    } else if (!take(home, first, task)) {
+        priority = second;
+        if (!take(home, second, task)) {
+            return false;
+        }
+    }
+
+    --queued;
+    // A task may run nested inside one of another class, e.g. an interactive band picked up
+    // by a bulk parallel_for() caller while it waits, so the class is saved and restored
+    task_priority outer = tls_priority;
+    bool was_bulk = outer == task_priority::bulk;
+    bool is_bulk = priority == task_priority::bulk;
+    if (is_bulk != was_bulk) {
+        is_bulk ? ++bulk_running : --bulk_running;
+    }
+    tls_priority = priority;
+    {
+        allocation_scope allocations(task.allocations);
+        pixel_copy_scope copies(task.copies);
+        task.run();
+    }
+    tls_priority = outer;
+    if (is_bulk != was_bulk) {
+        is_bulk ? --bulk_running : ++bulk_running;
+    }
+    if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        idle.notify_all();
+    }
+    return true;
+}
+
+void task_scheduler::worker_loop(std::size_t index) {
+    tls_scheduler = this;
+    tls_worker = index;
+    if (pinned) {
+        numa_topology::system().pin_current_thread(worker_node[index]);
+    }
+    for (;;) {
+        // Nested tasks run inside this call, so only top-level time is added
+        auto start = std::chrono::steady_clock::now();
+        if (run_one(index)) {
+            busy_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        work_available.wait(lock, [this, index] { return stopping || has_work_for(index); });
+        // Drain everything before honouring a stop request so no submitted task is lost
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+void task_scheduler::parallel_for(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<std::size_t>(grain, 1);
+    std::size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1) {
+        body(0, count);
+        return;
+    }
+
+    // Chunks are claimed from a counter by the caller and by the queued tasks alike. A queued
+    // task claims one chunk and returns, so its worker goes back to the deques between row
+    // bands and queued interactive work still preempts a bulk loop there. A task that runs
+    // after every chunk was claimed finds nothing left, so it may outlive this call; it
+    // therefore shares the state and touches body only for a chunk it claimed, which the
+    // caller is still waiting for.
+    struct loop_state {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> remaining{0};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<loop_state>();
+    state->remaining = chunks;
+    const std::function<void(std::size_t, std::size_t)>* loop_body = &body;
+    auto run_chunk = [state, loop_body, count, grain, chunks] {
+        std::size_t chunk = state->next++;
+        if (chunk >= chunks) {
+            return false;
+        }
+        try {
+            (*loop_body)(chunk * grain, std::min(count, (chunk + 1) * grain));
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state->error_mutex);
+            if (!state->error) {
+                state->error = std::current_exception();
+            }
+        }
+        --state->remaining;
+        return true;
+    };
+
+    for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+        submit([run_chunk] { run_chunk(); });
+    }
+
+    // The caller runs this loop's chunks, not unrelated tasks: another image's whole resize
+    // may block on a full encode queue and would hold this caller's buffers until it
+    // finished. The one exception keeps priorities working: a bulk caller still gives way to
+    // queued interactive work between its chunks, as a worker between tasks would.
+    std::size_t home = current_worker();
+    bool bulk_caller = tls_priority == task_priority::bulk;
+    auto give_way = [&] {
+        return bulk_caller && queued_by_priority[priority_index(task_priority::interactive)] > 0 && run_one(home, true);
+    };
+    do {
+        while (give_way()) {
+        }
+    } while (run_chunk());
+
+    // Every unclaimed chunk has been run, so the wait is only for chunks running elsewhere
+    while (state->remaining > 0) {
+        if (!give_way()) {
+            std::this_thread::yield();
+        }
+    }
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void task_scheduler::wait_idle() {
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+}
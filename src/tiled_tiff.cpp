@@ -0,0 +1,524 @@
+#include "tiled_tiff.h"
+#include "output_poison.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <zlib.h>
+
+using namespace cimg_library;
+
+namespace {
+
+enum tiff_tag : std::uint16_t {
+    tag_image_width = 256,
+    tag_image_length = 257,
+    tag_bits_per_sample = 258,
+    tag_compression = 259,
+    tag_photometric = 262,
+    tag_strip_offsets = 273,
+    tag_samples_per_pixel = 277,
+    tag_rows_per_strip = 278,
+    tag_strip_byte_counts = 279,
+    tag_planar_configuration = 284,
+    tag_predictor = 317,
+    tag_tile_width = 322,
+    tag_tile_length = 323,
+    tag_tile_offsets = 324,
+    tag_tile_byte_counts = 325,
+    tag_extra_samples = 338
+};
+
+enum tiff_type : std::uint16_t { type_short = 3, type_long = 4, type_long8 = 16 };
+
+std::size_t type_size(std::uint16_t type) {
+    switch (type) {
+    case 1: case 2: case 6: case 7: return 1;
+    case 3: case 8: return 2;
+    case 4: case 9: case 11: case 13: return 4;
+    case 5: case 10: case 12: case 16: case 17: case 18: return 8;
+    default: return 0;
+    }
+}
+
+void read_exact(int fd, std::uint64_t offset, void* buffer, std::size_t size) {
+    unsigned char* out = static_cast<unsigned char*>(buffer);
+    while (size > 0) {
+        ssize_t got = pread(fd, out, size, static_cast<off_t>(offset));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            throw std::runtime_error("TIFF read failed or file truncated");
+        }
+        out += got;
+        offset += static_cast<std::uint64_t>(got);
+        size -= static_cast<std::size_t>(got);
+    }
+}
+
+void write_exact(int fd, std::uint64_t offset, const void* buffer, std::size_t size) {
+    const unsigned char* in = static_cast<const unsigned char*>(buffer);
+    while (size > 0) {
+        ssize_t put = pwrite(fd, in, size, static_cast<off_t>(offset));
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            throw std::runtime_error(std::string("TIFF write failed: ") + std::strerror(errno));
+        }
+        in += put;
+        offset += static_cast<std::uint64_t>(put);
+        size -= static_cast<std::size_t>(put);
+    }
+}
+
+std::uint64_t decode_uint(const unsigned char* bytes, std::size_t size, bool big_endian) {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        value |= static_cast<std::uint64_t>(bytes[big_endian ? size - 1 - i : i]) << (8 * i);
+    }
+    return value;
+}
+
+void append_uint(std::vector<unsigned char>& out, std::uint64_t value, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+void store_uint(std::vector<unsigned char>& out, std::size_t position, std::uint64_t value, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+        out[position + i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+} // namespace
+
+tiff_reader::tiff_reader(const std::string& path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open '" + path + "'");
+    }
+
+    try {
+        unsigned char header[16];
+        read_exact(fd, 0, header, 8);
+        if (header[0] == 'I' && header[1] == 'I') {
+            big_endian = false;
+        } else if (header[0] == 'M' && header[1] == 'M') {
+            big_endian = true;
+        } else {
+            throw std::runtime_error("'" + path + "' is not a TIFF file");
+        }
+        std::uint64_t magic = decode_uint(header + 2, 2, big_endian);
+        bool big_tiff = magic == 43;
+        if (magic != 42 && !big_tiff) {
+            throw std::runtime_error("'" + path + "' is not a TIFF file");
+        }
+        std::uint64_t directory = decode_uint(header + 4, 4, big_endian);
+        if (big_tiff) {
+            read_exact(fd, 8, header + 8, 8);
+            directory = decode_uint(header + 8, 8, big_endian);
+        }
+
+        // Entry layout differs between classic TIFF and BigTIFF only in field widths
+        std::size_t count_size = big_tiff ? 8 : 2;
+        std::size_t entry_size = big_tiff ? 20 : 12;
+        std::size_t value_size = big_tiff ? 8 : 4;
+        unsigned char count_bytes[8];
+        read_exact(fd, directory, count_bytes, count_size);
+        std::uint64_t entry_count = decode_uint(count_bytes, count_size, big_endian);
+        std::vector<unsigned char> entries(entry_count * entry_size);
+        read_exact(fd, directory + count_size, entries.data(), entries.size());
+
+        auto values_of = [&](const unsigned char* entry) {
+            std::uint16_t type = static_cast<std::uint16_t>(decode_uint(entry + 2, 2, big_endian));
+            std::uint64_t count = decode_uint(entry + 4, big_tiff ? 8 : 4, big_endian);
+            std::size_t size = type_size(type);
+            if (type != 1 && type != type_short && type != type_long && type != type_long8) {
+                throw std::runtime_error("unsupported TIFF field type");
+            }
+            std::vector<unsigned char> raw(size * count);
+            const unsigned char* field = entry + 4 + (big_tiff ? 8 : 4);
+            if (raw.size() <= value_size) {
+                std::copy(field, field + raw.size(), raw.begin());
+            } else {
+                read_exact(fd, decode_uint(field, value_size, big_endian), raw.data(), raw.size());
+            }
+            std::vector<std::uint64_t> values(count);
+            for (std::uint64_t i = 0; i < count; ++i) {
+                values[i] = decode_uint(raw.data() + i * size, size, big_endian);
+            }
+            return values;
+        };
+        // Sizes are held as int, so a larger value is rejected instead of wrapping
+        auto int_of = [&](const unsigned char* entry) {
+            std::uint64_t value = values_of(entry).at(0);
+            if (value > static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+                throw std::runtime_error("TIFF size field out of range");
+            }
+            return static_cast<int>(value);
+        };
+
+        std::vector<std::uint64_t> bits_per_sample;
+        int planar = 1;
+        int photometric = 1;
+        int rows_per_strip = 0;
+        std::vector<std::uint64_t> strip_offsets, strip_byte_counts;
+        samples = 1;
+
+        for (std::uint64_t i = 0; i < entry_count; ++i) {
+            const unsigned char* entry = entries.data() + i * entry_size;
+            std::uint16_t tag = static_cast<std::uint16_t>(decode_uint(entry, 2, big_endian));
+            switch (tag) {
+            case tag_image_width: image_width = int_of(entry); break;
+            case tag_image_length: image_height = int_of(entry); break;
+            case tag_bits_per_sample: bits_per_sample = values_of(entry); break;
+            case tag_compression: compression = static_cast<int>(values_of(entry).at(0)); break;
+            case tag_photometric: photometric = static_cast<int>(values_of(entry).at(0)); break;
+            case tag_strip_offsets: strip_offsets = values_of(entry); break;
+            case tag_samples_per_pixel: samples = int_of(entry); break;
+            case tag_rows_per_strip: rows_per_strip = static_cast<int>(std::min<std::uint64_t>(values_of(entry).at(0), 1u << 30)); break;
+            case tag_strip_byte_counts: strip_byte_counts = values_of(entry); break;
+            case tag_planar_configuration: planar = static_cast<int>(values_of(entry).at(0)); break;
+            case tag_predictor: predictor = static_cast<int>(values_of(entry).at(0)); break;
+            case tag_tile_width: tile_w = int_of(entry); break;
+            case tag_tile_length: tile_h = int_of(entry); break;
+            case tag_tile_offsets: offsets = values_of(entry); break;
+            case tag_tile_byte_counts: byte_counts = values_of(entry); break;
+            default: break;
+            }
+        }
+
+        if (image_width <= 0 || image_height <= 0) {
+            throw std::runtime_error("TIFF has no image size");
+        }
+        for (std::uint64_t bits : bits_per_sample) {
+            if (bits != 8) {
+                throw std::runtime_error("only 8-bit TIFF samples are supported");
+            }
+        }
+        if (samples < 1 || planar != 1 || photometric == 3) {
+            throw std::runtime_error("only chunky, non-palette TIFFs are supported");
+        }
+        if (compression != 1 && compression != 8 && compression != 32946) {
+            throw std::runtime_error("unsupported TIFF compression " + std::to_string(compression));
+        }
+        if (predictor != 1 && predictor != 2) {
+            throw std::runtime_error("unsupported TIFF predictor " + std::to_string(predictor));
+        }
+
+        // A stripped file is read as a single column of full-width tiles
+        if (offsets.empty()) {
+            tile_w = image_width;
+            tile_h = rows_per_strip > 0 ? std::min(rows_per_strip, image_height) : image_height;
+            offsets = std::move(strip_offsets);
+            byte_counts = std::move(strip_byte_counts);
+        }
+        if (tile_w <= 0 || tile_h <= 0) {
+            throw std::runtime_error("TIFF has an invalid tile size");
+        }
+        tiles_across = static_cast<int>((static_cast<std::int64_t>(image_width) + tile_w - 1) / tile_w);
+        std::size_t tile_count = static_cast<std::size_t>(tiles_across) * ((static_cast<std::int64_t>(image_height) + tile_h - 1) / tile_h);
+        if (offsets.size() < tile_count || byte_counts.size() < tile_count) {
+            throw std::runtime_error("TIFF tile table is incomplete");
+        }
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+tiff_reader::~tiff_reader() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void tiff_reader::read_tile(int tile_x, int tile_y, std::vector<unsigned char>& pixels) const {
+    std::size_t index = static_cast<std::size_t>(tile_y) * tiles_across + tile_x;
+    std::size_t row_bytes = static_cast<std::size_t>(tile_w) * samples;
+    pixels.resize(row_bytes * tile_h);
+
+    std::vector<unsigned char> stored(byte_counts[index]);
+    read_exact(fd, offsets[index], stored.data(), stored.size());
+    std::size_t decoded_size = stored.size();
+    if (compression == 1) {
+        decoded_size = std::min(stored.size(), pixels.size());
+        std::copy(stored.begin(), stored.begin() + decoded_size, pixels.begin());
+    } else {
+        uLongf length = static_cast<uLongf>(pixels.size());
+        int status = uncompress(pixels.data(), &length, stored.data(), static_cast<uLong>(stored.size()));
+        // Either the stream ended, or it holds more than a tile and the tile was filled; a
+        // truncated stream also reports Z_BUF_ERROR, but leaves the buffer short
+        if (status != Z_OK && !(status == Z_BUF_ERROR && length == pixels.size())) {
+            throw std::runtime_error("corrupt Deflate data in TIFF tile");
+        }
+        decoded_size = length;
+    }
+    // A short tile must not show the previous tile's pixels through its missing rows
+    std::fill(pixels.begin() + decoded_size, pixels.end(), 0);
+
+    if (predictor == 2) {
+        for (std::size_t row = 0; row + row_bytes <= decoded_size; row += row_bytes) {
+            for (std::size_t i = samples; i < row_bytes; ++i) {
+                pixels[row + i] = static_cast<unsigned char>(pixels[row + i] + pixels[row + i - samples]);
+            }
+        }
+    }
+}
+
+void tiff_reader::read_region(const image_rect& rect, CImg<unsigned char>& out) const {
+    out.assign(rect.width, rect.height, 1, samples);
+    std::vector<unsigned char> tile;
+    for (int tile_y = rect.y / tile_h; tile_y <= (rect.y + rect.height - 1) / tile_h; ++tile_y) {
+        for (int tile_x = rect.x / tile_w; tile_x <= (rect.x + rect.width - 1) / tile_w; ++tile_x) {
+            read_tile(tile_x, tile_y, tile);
+            int x_begin = std::max(rect.x, tile_x * tile_w);
+            int x_end = static_cast<int>(std::min<std::int64_t>(rect.x + rect.width, static_cast<std::int64_t>(tile_x + 1) * tile_w));
+            int y_begin = std::max(rect.y, tile_y * tile_h);
+            int y_end = static_cast<int>(std::min<std::int64_t>(rect.y + rect.height, static_cast<std::int64_t>(tile_y + 1) * tile_h));
+            for (int y = y_begin; y < y_end; ++y) {
+                const unsigned char* in = tile.data() + (static_cast<std::size_t>(y - tile_y * tile_h) * tile_w + (x_begin - tile_x * tile_w)) * samples;
+                for (int x = x_begin; x < x_end; ++x) {
+                    for (int c = 0; c < samples; ++c) {
+                        out(x - rect.x, y - rect.y, 0, c) = *in++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+tiff_writer::tiff_writer(const std::string& path, int width, int height, int channels, int tile_width, int tile_height,
+                         tiff_compression compression)
+    : image_width(width), image_height(height), samples(channels), tile_w(tile_width), tile_h(tile_height),
+      compression(compression) {
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+        throw std::invalid_argument("TIFF output needs a positive size and 1 to 4 channels");
+    }
+    if (tile_width <= 0 || tile_height <= 0 || tile_width % 16 != 0 || tile_height % 16 != 0) {
+        throw std::invalid_argument("TIFF tile sizes must be positive multiples of 16");
+    }
+    tiles_across = (width + tile_w - 1) / tile_w;
+    std::size_t tile_count = static_cast<std::size_t>(tiles_across) * ((height + tile_h - 1) / tile_h);
+    offsets.assign(tile_count, 0);
+    byte_counts.assign(tile_count, 0);
+
+    // Leave generous room for the directory and for incompressible tiles
+    std::uint64_t raw_size = static_cast<std::uint64_t>(tile_count) * tile_w * tile_h * channels;
+    big_tiff = raw_size + raw_size / 64 + tile_count * 16 > 0xF0000000ull;
+
+    fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("cannot create '" + path + "'");
+    }
+    file_end = big_tiff ? 16 : 8;
+}
+
+tiff_writer::~tiff_writer() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void tiff_writer::write_tile(int tile_x, int tile_y, const CImg<unsigned char>& tile) {
+    // Edge tiles are stored at full size, padded with zeros
+    std::vector<unsigned char> pixels(static_cast<std::size_t>(tile_w) * tile_h * samples, 0);
+    int width = std::min(tile.width(), tile_w);
+    int height = std::min(tile.height(), tile_h);
+    for (int y = 0; y < height; ++y) {
+        unsigned char* out = pixels.data() + static_cast<std::size_t>(y) * tile_w * samples;
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < samples; ++c) {
+                *out++ = tile(x, y, 0, c);
+            }
+        }
+    }
+
+    std::vector<unsigned char> compressed;
+    const std::vector<unsigned char>* stored = &pixels;
+    if (compression == tiff_compression::deflate) {
+        uLongf length = compressBound(static_cast<uLong>(pixels.size()));
+        compressed.resize(length);
+        if (compress2(compressed.data(), &length, pixels.data(), static_cast<uLong>(pixels.size()), Z_DEFAULT_COMPRESSION) != Z_OK) {
+            throw std::runtime_error("TIFF tile compression failed");
+        }
+        compressed.resize(length);
+        stored = &compressed;
+    }
+
+    // Reserve the file range under the lock, write it without holding the lock
+    std::uint64_t offset;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        offset = file_end;
+        file_end += (stored->size() + 1) & ~static_cast<std::uint64_t>(1);
+        std::size_t index = static_cast<std::size_t>(tile_y) * tiles_across + tile_x;
+        offsets[index] = offset;
+        byte_counts[index] = stored->size();
+    }
+    write_exact(fd, offset, stored->data(), stored->size());
+}
+
+void tiff_writer::finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::uint64_t count : byte_counts) {
+        if (count == 0) {
+            throw std::runtime_error("TIFF output is missing tiles");
+        }
+    }
+
+    struct entry {
+        std::uint16_t tag;
+        std::uint16_t type;
+        std::vector<std::uint64_t> values;
+    };
+    std::uint16_t offset_type = big_tiff ? type_long8 : type_long;
+    std::vector<entry> entries = {
+        {tag_image_width, type_long, {static_cast<std::uint64_t>(image_width)}},
+        {tag_image_length, type_long, {static_cast<std::uint64_t>(image_height)}},
+        {tag_bits_per_sample, type_short, std::vector<std::uint64_t>(samples, 8)},
+        {tag_compression, type_short, {static_cast<std::uint64_t>(compression)}},
+        {tag_photometric, type_short, {samples >= 3 ? 2u : 1u}},
+        {tag_samples_per_pixel, type_short, {static_cast<std::uint64_t>(samples)}},
+        {tag_planar_configuration, type_short, {1}},
+        {tag_tile_width, type_long, {static_cast<std::uint64_t>(tile_w)}},
+        {tag_tile_length, type_long, {static_cast<std::uint64_t>(tile_h)}},
+        {tag_tile_offsets, offset_type, offsets},
+        {tag_tile_byte_counts, offset_type, byte_counts},
+    };
+    if (samples == 2 || samples == 4) {
+        entries.push_back({tag_extra_samples, type_short, {2}});
+    }
+
+    std::size_t count_size = big_tiff ? 8 : 2;
+    std::size_t entry_size = big_tiff ? 20 : 12;
+    std::size_t value_size = big_tiff ? 8 : 4;
+    std::uint64_t directory = file_end;
+    std::size_t directory_size = count_size + entries.size() * entry_size + value_size;
+
+    // Directory entries first, then the arrays that do not fit inline
+    std::vector<unsigned char> block;
+    append_uint(block, entries.size(), count_size);
+    std::vector<unsigned char> arrays;
+    for (const entry& e : entries) {
+        std::size_t size = type_size(e.type);
+        append_uint(block, e.tag, 2);
+        append_uint(block, e.type, 2);
+        append_uint(block, e.values.size(), big_tiff ? 8 : 4);
+        std::size_t field = block.size();
+        block.resize(block.size() + value_size, 0);
+        if (e.values.size() * size <= value_size) {
+            for (std::size_t i = 0; i < e.values.size(); ++i) {
+                store_uint(block, field + i * size, e.values[i], size);
+            }
+        } else {
+            store_uint(block, field, directory + directory_size + arrays.size(), value_size);
+            for (std::uint64_t value : e.values) {
+                append_uint(arrays, value, size);
+            }
+        }
+    }
+    append_uint(block, 0, value_size);
+    block.insert(block.end(), arrays.begin(), arrays.end());
+    write_exact(fd, directory, block.data(), block.size());
+
+    std::vector<unsigned char> header = {'I', 'I'};
+    if (big_tiff) {
+        append_uint(header, 43, 2);
+        append_uint(header, 8, 2);
+        append_uint(header, 0, 2);
+        append_uint(header, directory, 8);
+    } else {
+        append_uint(header, 42, 2);
+        append_uint(header, directory, 4);
+    }
+    write_exact(fd, 0, header.data(), header.size());
+
+    if (close(fd) != 0) {
+        fd = -1;
+        throw std::runtime_error("closing the TIFF output failed");
+    }
+    fd = -1;
+}
+
+namespace {
+
+/**
+ * @brief Resizes every output tile on the scheduler, each straight into output when it is
+ * given and otherwise into an image of its own that is handed to sink.
+ */
+void resize_tiles(const tiff_reader& reader, const resize_image_base& resizer, int new_width, int new_height,
+                  const tiled_resize_options& options, task_scheduler& scheduler, const mutable_image_view& output,
+                  const std::function<void(const image_rect&, const CImg<unsigned char>&)>& sink,
+                  const cancellation_token& cancel) {
+    resize_geometry geometry{reader.width(), reader.height(), new_width, new_height};
+    int tiles_across = (new_width + options.tile_width - 1) / options.tile_width;
+    int tiles_down = (new_height + options.tile_height - 1) / options.tile_height;
+    std::atomic<bool> failed(false);
+
+    scheduler.parallel_for(static_cast<std::size_t>(tiles_across) * tiles_down, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index < end && !failed; ++index) {
+            int tile_x = static_cast<int>(index % tiles_across);
+            int tile_y = static_cast<int>(index / tiles_across);
+            try {
+                image_rect rect{tile_x * options.tile_width, tile_y * options.tile_height,
+                                std::min(options.tile_width, new_width - tile_x * options.tile_width),
+                                std::min(options.tile_height, new_height - tile_y * options.tile_height)};
+                CImg<unsigned char> tile;
+                if (output.empty()) {
+                    tile = uninitialized_output(rect.width, rect.height, reader.channels());
+                }
+                mutable_image_view target = output.empty() ? mutable_image_view(tile) : output.crop(rect);
+                CImg<unsigned char> window;
+
+                // Halve the band height until the source window of a band fits the budget
+                int band_rows = rect.height;
+                for (int y = rect.y; y < rect.y + rect.height; y += band_rows) {
+                    band_rows = std::min(band_rows, rect.y + rect.height - y);
+                    image_rect band{rect.x, y, rect.width, band_rows};
+                    image_rect footprint = resizer.source_footprint(geometry, band);
+                    while (band_rows > 1 && static_cast<std::size_t>(footprint.width) * footprint.height * reader.channels() > options.window_budget) {
+                        band_rows = (band_rows + 1) / 2;
+                        band.height = band_rows;
+                        footprint = resizer.source_footprint(geometry, band);
+                    }
+                    cancel.throw_if_cancelled();
+                    reader.read_region(footprint, window);
+                    resizer.resize_region(window, footprint.x, footprint.y, target, rect.x, rect.y, geometry, band);
+                }
+                if (sink) {
+                    sink(rect, tile);
+                }
+            } catch (...) {
+                // Stop the remaining tiles early; parallel_for rethrows the first failure
+                failed = true;
+                throw;
+            }
+        }
+    });
+}
+
+} // namespace
+
+void resize_tiled(const tiff_reader& reader, const resize_image_base& resizer, int new_width, int new_height,
+                  const tiled_resize_options& options, task_scheduler& scheduler,
+                  const std::function<void(const image_rect&, const CImg<unsigned char>&)>& sink,
+                  const cancellation_token& cancel) {
+    resize_tiles(reader, resizer, new_width, new_height, options, scheduler, mutable_image_view(), sink, cancel);
+}
+
+void resize_tiled(const tiff_reader& reader, const resize_image_base& resizer, const tiled_resize_options& options,
+                  task_scheduler& scheduler, const mutable_image_view& output, const cancellation_token& cancel) {
+    if (output.channels() != reader.channels()) {
+        throw std::invalid_argument("resize_tiled: the output needs as many channels as the source");
+    }
+    resize_tiles(reader, resizer, output.width(), output.height(), options, scheduler, output, nullptr, cancel);
+}
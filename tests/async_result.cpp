@@ -0,0 +1,107 @@
+// Checks resize_async and the async_result combinators: a then() chain across executors,
+// on_complete(), co_await on a result, and that errors and cancellation skip the remaining
+// stages and reach get().
+
+#include "CImg.h"
+#include "async_result.h"
+#include "cancellation_token.h"
+#include "check.h"
+#include "resizer_factory.h"
+#include "task.h"
+#include "task_scheduler.h"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+using namespace cimg_library;
+
+namespace {
+
+CImg<unsigned char> pattern(int width, int height) {
+    CImg<unsigned char> image(width, height, 1, 3);
+    cimg_forXYC(image, x, y, c) {
+        image(x, y, 0, c) = static_cast<unsigned char>((x * 7 + y * 3 + c * 85) & 0xFF);
+    }
+    return image;
+}
+
+task<CImg<unsigned char>> await_resize(const resize_image_base& resizer, CImg<unsigned char> source, task_scheduler& scheduler) {
+    CImg<unsigned char> resized = co_await resizer.resize_async(std::move(source), 40, 30, scheduler);
+    co_return resized;
+}
+
+} // namespace
+
+int main() {
+    std::unique_ptr<resize_image_base> resizer = create_resizer("bilinear");
+    task_scheduler scheduler(2);
+    inline_executor inline_stage;
+    const CImg<unsigned char> source = pattern(160, 120);
+    const CImg<unsigned char> expected = resizer->resize(source, 40, 30);
+
+    // A chain hops from the scheduler to an inline stage and keeps each stage's value
+    {
+        std::atomic<int> stages(0);
+        int width = resizer->resize_async(CImg<unsigned char>(source), 40, 30, scheduler)
+                        .then(scheduler, [&](CImg<unsigned char> resized) {
+                            ++stages;
+                            CHECK(resized == expected);
+                            return resized;
+                        })
+                        .then(inline_stage, [&](CImg<unsigned char> resized) {
+                            ++stages;
+                            return resized.width();
+                        })
+                        .get();
+        CHECK(width == 40);
+        CHECK(stages == 2);
+    }
+
+    // An invalid size fails the first stage; later stages are skipped and get() rethrows
+    {
+        std::atomic<bool> continued(false);
+        async_result<void> chained = resizer->resize_async(CImg<unsigned char>(source), 0, 30, scheduler)
+                                         .then(scheduler, [&](CImg<unsigned char>) { continued = true; });
+        bool invalid = false;
+        try {
+            chained.get();
+        } catch (const std::invalid_argument&) {
+            invalid = true;
+        }
+        CHECK(invalid);
+        CHECK(!continued);
+    }
+
+    // A token cancelled before submission stops the resize before it allocates its output
+    {
+        cancellation_token cancel = cancellation_token::create();
+        cancel.cancel();
+        async_result<CImg<unsigned char>> cancelled = resizer->resize_async(CImg<unsigned char>(source), 40, 30, scheduler, cancel);
+        bool stopped = false;
+        try {
+            cancelled.get();
+        } catch (const operation_cancelled&) {
+            stopped = true;
+        }
+        CHECK(stopped);
+    }
+
+    // on_complete hands over a finished result whose get() does not block
+    {
+        async_promise<bool> done;
+        async_result<bool> finished = done.result();
+        resizer->resize_async(CImg<unsigned char>(source), 40, 30, scheduler)
+            .on_complete(scheduler, [done](async_result<CImg<unsigned char>> result) mutable {
+                CHECK(result.ready());
+                done.set_value(result.get().width() == 40);
+            });
+        CHECK(finished.get());
+    }
+
+    // A coroutine can await a result directly
+    CHECK(sync_wait(await_resize(*resizer, CImg<unsigned char>(source), scheduler)) == expected);
+
+    scheduler.wait_idle();
+    return check_result("async_result");
+}
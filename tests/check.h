@@ -0,0 +1,37 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <iostream>
+
+// Minimal assertions for the programs under tests/: a failed check is reported and counted,
+// and the program's exit status is the number of failures, so `make check` stops on it.
+
+namespace check_detail {
+inline int failures = 0;
+}
+
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            ++check_detail::failures;                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+        }                                                                                     \
+    } while (0)
+
+#define CHECK_THROWS(expression)                                                              \
+    do {                                                                                      \
+        bool thrown = false;                                                                  \
+        try {                                                                                 \
+            expression;                                                                       \
+        } catch (...) {                                                                       \
+            thrown = true;                                                                    \
+        }                                                                                     \
+        CHECK(thrown && "" #expression " throws");                                            \
+    } while (0)
+
+inline int check_result(const char* name) {
+    std::cout << name << ": " << (check_detail::failures ? "FAILED" : "ok") << std::endl;
+    return check_detail::failures;
+}
+
+#endif // TESTS_CHECK_H
@@ -0,0 +1,87 @@
+// Checks the coroutine steps of image_tasks.h: a load, resize and save chain, a failing load,
+// a cancelled resize, and that schedule_on() moves a coroutine onto a scheduler worker.
+
+#include "CImg.h"
+#include "cancellation_token.h"
+#include "check.h"
+#include "image_tasks.h"
+#include "resizer_factory.h"
+#include "task.h"
+#include "task_scheduler.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace cimg_library;
+
+namespace {
+
+CImg<unsigned char> pattern(int width, int height) {
+    CImg<unsigned char> image(width, height, 1, 3);
+    cimg_forXYC(image, x, y, c) {
+        image(x, y, 0, c) = static_cast<unsigned char>((x * 7 + y * 3 + c * 85) & 0xFF);
+    }
+    return image;
+}
+
+task<void> load_resize_save(const resize_image_base& resizer, std::string in, std::string out, task_scheduler& scheduler) {
+    CImg<unsigned char> image = co_await load_task(in, scheduler);
+    CImg<unsigned char> resized = co_await resize_task(resizer, std::move(image), 40, 30, scheduler);
+    co_await save_task(std::move(resized), out, png_options(), scheduler);
+}
+
+task<std::thread::id> resumed_on(task_scheduler& scheduler) {
+    co_await schedule_on(scheduler);
+    co_return std::this_thread::get_id();
+}
+
+} // namespace
+
+int main() {
+    cimg::exception_mode(0);
+    std::unique_ptr<resize_image_base> resizer = create_resizer("bilinear");
+    task_scheduler scheduler(2);
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "resize_image_test_image_tasks";
+    std::filesystem::create_directories(dir);
+    const CImg<unsigned char> source = pattern(160, 120);
+    const std::string in = (dir / "in.png").string();
+    const std::string out = (dir / "out.png").string();
+    source.save(in.c_str());
+
+    // The chain writes what a direct resize of the decoded file gives
+    std::filesystem::remove(out);
+    sync_wait(load_resize_save(*resizer, in, out, scheduler));
+    CHECK(std::filesystem::exists(out));
+    if (std::filesystem::exists(out)) {
+        CImg<unsigned char> written(out.c_str());
+        CHECK(written == resizer->resize(CImg<unsigned char>(in.c_str()), 40, 30));
+    }
+
+    // A missing input surfaces as CImg's exception at the awaiting caller
+    bool load_failed = false;
+    try {
+        sync_wait(load_task((dir / "missing.png").string(), scheduler));
+    } catch (const CImgIOException&) {
+        load_failed = true;
+    }
+    CHECK(load_failed);
+
+    // A cancelled token stops the resize step
+    cancellation_token cancel = cancellation_token::create();
+    cancel.cancel();
+    bool cancelled = false;
+    try {
+        sync_wait(resize_task(*resizer, CImg<unsigned char>(source), 40, 30, scheduler, cancel));
+    } catch (const operation_cancelled&) {
+        cancelled = true;
+    }
+    CHECK(cancelled);
+
+    // After schedule_on() the coroutine continues on a worker, not the thread that started it
+    CHECK(sync_wait(resumed_on(scheduler)) != std::this_thread::get_id());
+
+    scheduler.wait_idle();
+    std::filesystem::remove_all(dir);
+    return check_result("image_tasks");
+}
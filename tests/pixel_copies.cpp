@@ -0,0 +1,32 @@
+// Checks that pixel_copy_scope counts follow work onto scheduler workers, including the
+// chunks of a parallel_for(), and stop at a null scope.
+
+#include "check.h"
+#include "pixel_copies.h"
+#include "task_scheduler.h"
+#include <atomic>
+
+int main() {
+    task_scheduler scheduler(2);
+    std::atomic<unsigned long long> job(0);
+    std::atomic<unsigned long long> other(0);
+    {
+        pixel_copy_scope copies(&job);
+        count_pixel_copy(1);
+        scheduler.submit([] { count_pixel_copy(10); });
+        scheduler.parallel_for(8, 1, [](std::size_t begin, std::size_t end) { count_pixel_copy(100 * (end - begin)); });
+        {
+            pixel_copy_scope inner(&other);
+            scheduler.submit([] { count_pixel_copy(5); });
+        }
+        {
+            pixel_copy_scope untracked(nullptr);
+            scheduler.submit([] { count_pixel_copy(1000); });
+        }
+        scheduler.wait_idle();
+    }
+    count_pixel_copy(10000);
+    CHECK(job == 811);
+    CHECK(other == 5);
+    return check_result("pixel_copies");
+}
@@ -0,0 +1,95 @@
+// Regression check for priority classes: interactive thumbnails submitted while bulk resizes
+// saturate the workers must finish in about the time of one row band, not of a bulk job.
+//
+// Runs the two-class scenario of bench_priority_latency on two workers and fails when the
+// interactive p50 or p99 latency exceeds a bound far above the expected ~1 ms but far below
+// the hundreds of milliseconds seen when a bulk parallel_for() caller ignores queued
+// interactive work.
+
+#include "CImg.h"
+#include "check.h"
+#include "resizer_factory.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace cimg_library;
+
+namespace {
+
+using test_clock = std::chrono::steady_clock;
+
+const double p50_limit_ms = 20.0;
+const double p99_limit_ms = 60.0;
+
+CImg<unsigned char> pattern(int width, int height) {
+    CImg<unsigned char> image(width, height, 1, 3);
+    cimg_forXYC(image, x, y, c) {
+        image(x, y, 0, c) = static_cast<unsigned char>((x * 7 + y * 3 + c * 85) & 0xFF);
+    }
+    return image;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size()));
+    return values[index];
+}
+
+} // namespace
+
+int main() {
+    const int requests = 40;
+    const int interval_ms = 10;
+    const std::size_t bulk_jobs = 4;
+
+    std::unique_ptr<resize_image_base> resizer = create_resizer("bilinear");
+    task_scheduler scheduler(2);
+
+    const CImg<unsigned char> bulk_source = pattern(4096, 4096);
+    const CImg<unsigned char> request_source = pattern(512, 512);
+    std::atomic<bool> stop(false);
+    std::vector<CImg<unsigned char>> bulk_results(bulk_jobs, CImg<unsigned char>(2048, 2048, 1, 3));
+    std::function<void(std::size_t)> bulk_job = [&](std::size_t job) {
+        resizer->resize_parallel(bulk_source, bulk_results[job], scheduler);
+        if (!stop) {
+            scheduler.submit([&bulk_job, job] { bulk_job(job); }, task_priority::bulk);
+        }
+    };
+    for (std::size_t job = 0; job < bulk_jobs; ++job) {
+        scheduler.submit([&bulk_job, job] { bulk_job(job); }, task_priority::bulk);
+    }
+
+    std::mutex latencies_mutex;
+    std::vector<double> latencies;
+    std::vector<CImg<unsigned char>> thumbnails(requests, CImg<unsigned char>(128, 128, 1, 3));
+    auto next = test_clock::now();
+    for (int i = 0; i < requests; ++i) {
+        std::this_thread::sleep_until(next);
+        next += std::chrono::milliseconds(interval_ms);
+        auto submitted = test_clock::now();
+        scheduler.submit([&, i, submitted] {
+            resizer->resize_parallel(request_source, thumbnails[i], scheduler);
+            double ms = std::chrono::duration<double, std::milli>(test_clock::now() - submitted).count();
+            std::lock_guard<std::mutex> lock(latencies_mutex);
+            latencies.push_back(ms);
+        }, task_priority::interactive);
+    }
+    stop = true;
+    scheduler.wait_idle();
+
+    double p50 = percentile(latencies, 0.5);
+    double p99 = percentile(latencies, 0.99);
+    std::cout << "interactive latency with bulk load: p50 " << p50 << " ms, p99 " << p99 << " ms" << std::endl;
+    CHECK(latencies.size() == static_cast<std::size_t>(requests));
+    CHECK(p50 < p50_limit_ms);
+    CHECK(p99 < p99_limit_ms);
+    return check_result("priority_latency");
+}